@@ -0,0 +1,56 @@
+#include "simplefs-batch.h"
+
+// Array for storing opened files
+extern struct filehandle_t file_handle_array[MAX_OPEN_FILES];
+
+// Run the `count` operations in `ops` in order, setting each `result`. The
+// superblock and inode table are read once for the whole batch and each
+// changed metadata block written once at the end. Reads and writes are
+// positional and leave handle offsets alone. Returns the number of
+// operations that failed
+int simplefs_submit(struct batch_op_t *ops, int count) {
+  int failed = 0;
+  int last_open = -1;
+
+  simplefs_beginBatch();
+  for (int i = 0; i < count; i++) {
+    struct batch_op_t *op = &ops[i];
+    int file_handle =
+        op->file_handle == BATCH_LAST_OPEN ? last_open : op->file_handle;
+    int handle_ok = file_handle >= 0 && file_handle < MAX_OPEN_FILES &&
+                    file_handle_array[file_handle].inode_number != -1;
+
+    switch (op->op) {
+    case BATCH_CREATE:
+      op->result = simplefs_create(op->filename);
+      break;
+    case BATCH_OPEN:
+      op->result = last_open = simplefs_open(op->filename);
+      break;
+    case BATCH_WRITE:
+      op->result = handle_ok ? simplefs_pwrite(file_handle, op->buf,
+                                               op->nbytes, op->offset)
+                             : -1;
+      break;
+    case BATCH_READ:
+      op->result = handle_ok ? simplefs_pread(file_handle, op->buf,
+                                              op->nbytes, op->offset)
+                             : -1;
+      break;
+    case BATCH_CLOSE:
+      op->result = handle_ok ? 0 : -1;
+      if (handle_ok)
+        simplefs_close(file_handle);
+      break;
+    case BATCH_DELETE:
+      op->result = 0;
+      simplefs_delete(op->filename);
+      break;
+    default:
+      op->result = -1;
+    }
+    failed += op->result == -1;
+  }
+  simplefs_endBatch();
+  return failed;
+}
@@ -0,0 +1,28 @@
+// BATCHED OPERATIONS
+#ifndef SIMPLEFS_BATCH_H
+#define SIMPLEFS_BATCH_H
+
+#include "simplefs-ops.h"
+
+#define BATCH_CREATE 0
+#define BATCH_OPEN 1
+#define BATCH_WRITE 2
+#define BATCH_READ 3
+#define BATCH_CLOSE 4
+#define BATCH_DELETE 5
+#define BATCH_LAST_OPEN -1 // `file_handle` of the latest BATCH_OPEN
+
+// One operation of a batch passed to simplefs_submit
+struct batch_op_t {
+  int op;          // BATCH_* operation
+  char *filename;  // file to create, open or delete
+  int file_handle; // handle to write, read or close, or BATCH_LAST_OPEN
+  char *buf;       // data to write or room for data read
+  int nbytes;      // bytes to write or read
+  int offset;      // file offset to write or read at
+  int result;      // set to what the single call would have returned
+};
+
+int simplefs_submit(struct batch_op_t *ops, int count);
+
+#endif
@@ -0,0 +1,194 @@
+#include "simplefs-build.h"
+#include "simplefs-dir.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+// Where one file of a build goes
+struct build_plan_t {
+  int inode_number;                   // -1 for a directory already made
+  int start;                          // first of its consecutive data
+                                      // blocks, -1 if its data are inline
+  int blocks;                         // data blocks from `start`
+  char inline_data[INLINE_DATA_SIZE]; // data if `start` is -1
+};
+
+// State shared by the reader threads
+struct build_state_t {
+  struct build_file_t *files;
+  struct build_plan_t *plans;
+  char data[NUM_DATA_BLOCKS * BLOCKSIZE]; // data blocks as they are written
+  atomic_int failed;                      // set if a host file fell short
+};
+
+// Range of files [first, last) read by one thread
+struct build_job_t {
+  struct build_state_t *state;
+  int first;
+  int last;
+};
+
+// Create the directories on the way to `path` that are not there yet.
+// Returns -1 if one can't be made
+static int simplefs_buildParents(char *path) {
+  char *prefix = strdup(path);
+  int ret = 0;
+  for (char *slash = strchr(prefix + 1, '/'); slash != NULL && ret == 0;
+       slash = strchr(slash + 1, '/')) {
+    *slash = '\0';
+    if (simplefs_lookupPath(prefix) == -1 && simplefs_mkdir(prefix) == -1)
+      ret = -1;
+    *slash = '/';
+  }
+  free(prefix);
+  return ret;
+}
+
+// Create the inode of `file` and give it a run of consecutive data blocks,
+// or keep it inline if it is small enough. Returns -1 if it doesn't fit or
+// its path is taken
+static int simplefs_planFile(struct build_file_t *file,
+                             struct build_plan_t *plan) {
+  plan->inode_number = -1;
+  plan->start = -1;
+  plan->blocks = 0;
+  if (simplefs_buildParents(file->path) == -1)
+    return -1;
+
+  // Directories may have been made for the files inside them already
+  if (file->source == NULL) {
+    int inodenum = simplefs_lookupPath(file->path);
+    if (inodenum != -1)
+      return simplefs_inodeFlags(inodenum) & INODE_FLAG_DIR ? 0 : -1;
+    plan->inode_number = simplefs_mkdir(file->path);
+    return plan->inode_number == -1 ? -1 : 0;
+  }
+
+  if (file->size < 0 || file->size > MAX_FILE_SIZE * BLOCKSIZE ||
+      simplefs_lookupPath(file->path) != -1)
+    return -1;
+  plan->inode_number = simplefs_createEntry(file->path, INODE_FLAG_INLINE);
+  if (plan->inode_number == -1)
+    return -1;
+  if (file->size <= INLINE_DATA_SIZE)
+    return 0;
+  plan->blocks = (file->size + BLOCKSIZE - 1) / BLOCKSIZE;
+  plan->start = simplefs_allocDataRun(plan->blocks, NUM_DATA_BLOCKS);
+  return plan->start == -1 ? -1 : 0;
+}
+
+// Read the host files of files [first, last) to where they were planned
+static void *simplefs_buildWorker(void *arg) {
+  struct build_job_t *job = (struct build_job_t *)arg;
+  struct build_state_t *state = job->state;
+
+  for (int i = job->first; i < job->last && !atomic_load(&state->failed);
+       i++) {
+    struct build_file_t *file = &state->files[i];
+    struct build_plan_t *plan = &state->plans[i];
+    if (file->source == NULL)
+      continue;
+    char *dst = plan->start == -1 ? plan->inline_data
+                                  : state->data + plan->start * BLOCKSIZE;
+    int done = 0;
+    int fd = open(file->source, O_RDONLY);
+    while (fd != -1 && done < file->size) {
+      ssize_t ret = pread(fd, dst + done, file->size - done, done);
+      if (ret <= 0)
+        break;
+      done += ret;
+    }
+    if (fd != -1)
+      close(fd);
+    if (done < file->size)
+      atomic_store(&state->failed, 1);
+  }
+  return NULL;
+}
+
+// Format the disk and fill it with the `count` files and directories in
+// `files` in one pass. Every file is laid out first, on consecutive blocks,
+// with the metadata held in memory. Then `nthreads` threads read the host
+// files and the data go out in as few writes as the layout allows, the
+// metadata in one write at the end. Returns -1 if a host file can't be read
+// in full, a path is taken or the files don't fit, the disk is then left
+// empty
+int simplefs_buildImage(struct build_file_t *files, int count, int nthreads) {
+  simplefs_formatDisk();
+  struct build_state_t *state =
+      (struct build_state_t *)calloc(1, sizeof(struct build_state_t));
+  state->files = files;
+  state->plans =
+      (struct build_plan_t *)calloc(count, sizeof(struct build_plan_t));
+
+  simplefs_beginBatch();
+  int ret = 0;
+  for (int i = 0; i < count && ret == 0; i++)
+    ret = simplefs_planFile(&files[i], &state->plans[i]);
+
+  // Read the host files in parallel
+  if (ret == 0 && count > 0) {
+    if (nthreads < 1)
+      nthreads = 1;
+    if (nthreads > BUILD_MAX_THREADS)
+      nthreads = BUILD_MAX_THREADS;
+    if (nthreads > count)
+      nthreads = count;
+    pthread_t threads[BUILD_MAX_THREADS];
+    struct build_job_t jobs[BUILD_MAX_THREADS];
+    for (int t = 0; t < nthreads; t++) {
+      jobs[t].state = state;
+      jobs[t].first = count * t / nthreads;
+      jobs[t].last = count * (t + 1) / nthreads;
+      pthread_create(&threads[t], NULL, simplefs_buildWorker, &jobs[t]);
+    }
+    for (int t = 0; t < nthreads; t++)
+      pthread_join(threads[t], NULL);
+    if (atomic_load(&state->failed))
+      ret = -1;
+  }
+
+  // One write per run of planned blocks
+  if (ret == 0) {
+    char planned[NUM_DATA_BLOCKS];
+    memset(planned, 0, sizeof(planned));
+    for (int i = 0; i < count; i++)
+      if (state->plans[i].start != -1)
+        memset(planned + state->plans[i].start, 1, state->plans[i].blocks);
+    for (int b = 0, run; b < NUM_DATA_BLOCKS; b += run) {
+      run = 1;
+      if (!planned[b])
+        continue;
+      while (b + run < NUM_DATA_BLOCKS && planned[b + run])
+        run++;
+      simplefs_writeDataBlocks(b, run, state->data + b * BLOCKSIZE);
+    }
+  }
+
+  // Point the inodes at their data
+  struct inode_t *inode = (struct inode_t *)malloc(sizeof(struct inode_t));
+  for (int i = 0; i < count && ret == 0; i++) {
+    struct build_plan_t *plan = &state->plans[i];
+    if (files[i].source == NULL)
+      continue;
+    simplefs_readInode(plan->inode_number, inode);
+    inode->file_size = files[i].size;
+    if (plan->start == -1) {
+      memcpy(inode->inline_data, plan->inline_data, INLINE_DATA_SIZE);
+    } else {
+      inode->flags &= ~INODE_FLAG_INLINE;
+      for (int j = 0; j < plan->blocks; j++)
+        inode->direct_blocks[j] = plan->start + j;
+    }
+    simplefs_writeInode(plan->inode_number, inode);
+  }
+  free(inode); // Free malloced data
+  simplefs_endBatch();
+  free(state->plans);
+  free(state);
+
+  // Nothing is kept of a build that failed
+  if (ret == -1)
+    simplefs_formatDisk();
+  return ret;
+}
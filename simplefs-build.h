@@ -0,0 +1,19 @@
+// BULK IMAGE BUILDING
+#ifndef SIMPLEFS_BUILD_H
+#define SIMPLEFS_BUILD_H
+
+#include "simplefs-disk.h"
+
+#define BUILD_MAX_THREADS 8
+
+// File or directory put on the disk by simplefs_buildImage
+struct build_file_t {
+  char *path;         // where it goes, '/' separated inside directories
+  const char *source; // host file its data are read from, NULL for a
+                      // directory
+  int size;           // bytes of `source` to copy
+};
+
+int simplefs_buildImage(struct build_file_t *files, int count, int nthreads);
+
+#endif
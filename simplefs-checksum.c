@@ -0,0 +1,183 @@
+#include "simplefs-checksum.h"
+
+#include <pthread.h>
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <nmmintrin.h>
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+#define CRC32C_POLY 0x82f63b78 // Castagnoli polynomial, bit reflected
+
+// pointer to simplefs.txt
+extern int DISK_FD;
+
+static_assert(NUM_DATA_BLOCKS * sizeof(uint32_t) <=
+                  NUM_CHECKSUM_BLOCKS * BLOCKSIZE,
+              "checksums must fit in their blocks");
+
+// Checksums of the data blocks, read from disk on first use. Held with the
+// I/O they check, so a block and its checksum are always seen together
+static uint32_t checksums[NUM_DATA_BLOCKS];
+static int checksums_loaded;
+// Blocks [dirty_first, dirty_end) whose checksums are held back by a batch
+static int dirty_first = NUM_DATA_BLOCKS, dirty_end;
+static pthread_mutex_t checksum_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Byte at a time table for CPUs without CRC32C instructions, and whether
+// this one has them
+static uint32_t crc_table[256];
+static int crc_hardware;
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+
+static void simplefs_initCrc() {
+  for (uint32_t i = 0; i < 256; i++) {
+    uint32_t crc = i;
+    for (int bit = 0; bit < 8; bit++)
+      crc = crc & 1 ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+    crc_table[i] = crc;
+  }
+#if defined(__x86_64__) && defined(__GNUC__)
+  crc_hardware = __builtin_cpu_supports("sse4.2");
+#elif defined(__ARM_FEATURE_CRC32)
+  crc_hardware = 1;
+#endif
+}
+
+// The CRC32C instructions, 8 bytes at a time. Built for SSE4.2 whatever the
+// compiler flags, and only called once the CPU is known to have it
+#if defined(__x86_64__) && defined(__GNUC__)
+__attribute__((target("sse4.2"))) static uint32_t
+simplefs_crc32cHardware(uint32_t crc, const char *buf, int nbytes) {
+  uint64_t crc64 = crc;
+  int i = 0;
+  for (; i + 8 <= nbytes; i += 8) {
+    uint64_t word;
+    memcpy(&word, buf + i, sizeof(word));
+    crc64 = _mm_crc32_u64(crc64, word);
+  }
+  crc = (uint32_t)crc64;
+  for (; i < nbytes; i++)
+    crc = _mm_crc32_u8(crc, (unsigned char)buf[i]);
+  return crc;
+}
+#elif defined(__ARM_FEATURE_CRC32)
+static uint32_t simplefs_crc32cHardware(uint32_t crc, const char *buf,
+                                        int nbytes) {
+  int i = 0;
+  for (; i + 8 <= nbytes; i += 8) {
+    uint64_t word;
+    memcpy(&word, buf + i, sizeof(word));
+    crc = __crc32cd(crc, word);
+  }
+  for (; i < nbytes; i++)
+    crc = __crc32cb(crc, (unsigned char)buf[i]);
+  return crc;
+}
+#else
+static uint32_t simplefs_crc32cHardware(uint32_t crc, const char *buf,
+                                        int nbytes) {
+  (void)buf;
+  (void)nbytes;
+  return crc;
+}
+#endif
+
+// CRC32C of `nbytes` of `buf`, continuing from `crc`, 0 to start
+uint32_t simplefs_crc32c(uint32_t crc, const char *buf, int nbytes) {
+  pthread_once(&crc_once, simplefs_initCrc);
+  crc = ~crc;
+  if (crc_hardware)
+    return ~simplefs_crc32cHardware(crc, buf, nbytes);
+  for (int i = 0; i < nbytes; i++)
+    crc = crc_table[(crc ^ (unsigned char)buf[i]) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
+void simplefs_lockChecksums() { pthread_mutex_lock(&checksum_lock); }
+
+void simplefs_unlockChecksums() { pthread_mutex_unlock(&checksum_lock); }
+
+// The checksums, read from disk if this disk hasn't used them yet. The
+// caller holds the checksum lock
+static uint32_t *simplefs_loadChecksums() {
+  if (!checksums_loaded) {
+    int ret = pread(DISK_FD, checksums, sizeof(checksums),
+                    BLOCKSIZE * CHECKSUM_START);
+    assert(ret == sizeof(checksums));
+    checksums_loaded = 1;
+  }
+  return checksums;
+}
+
+// Write the checksums of `count` data blocks from `blocknum` back to disk.
+// The caller holds the checksum lock
+static void simplefs_writeChecksums(int blocknum, int count) {
+  int ret = pwrite(DISK_FD, checksums + blocknum, count * sizeof(uint32_t),
+                   BLOCKSIZE * CHECKSUM_START + blocknum * sizeof(uint32_t));
+  assert(ret == count * (int)sizeof(uint32_t));
+}
+
+// Set the checksum of every data block to that of a block of zeros, as a
+// freshly formatted disk holds
+void simplefs_formatChecksums() {
+  char zeros[BLOCKSIZE];
+  memset(zeros, 0, BLOCKSIZE);
+  uint32_t crc = simplefs_crc32c(0, zeros, BLOCKSIZE);
+  simplefs_lockChecksums();
+  for (int i = 0; i < NUM_DATA_BLOCKS; i++)
+    checksums[i] = crc;
+  checksums_loaded = 1;
+  simplefs_writeChecksums(0, NUM_DATA_BLOCKS);
+  simplefs_unlockChecksums();
+}
+
+// Drop the checksums held in memory, they are read from disk again on next
+// use
+void simplefs_invalidateChecksums() {
+  simplefs_lockChecksums();
+  checksums_loaded = 0;
+  dirty_first = NUM_DATA_BLOCKS;
+  dirty_end = 0;
+  simplefs_unlockChecksums();
+}
+
+// Write back the checksums held back since simplefs_storeChecksums was last
+// told to defer them, in one write
+void simplefs_flushChecksums() {
+  simplefs_lockChecksums();
+  if (dirty_first < dirty_end)
+    simplefs_writeChecksums(dirty_first, dirty_end - dirty_first);
+  dirty_first = NUM_DATA_BLOCKS;
+  dirty_end = 0;
+  simplefs_unlockChecksums();
+}
+
+// Check `count` data blocks from `blocknum`, read into `buf`, against their
+// checksums. Returns -1 if one differs. The caller holds the checksum lock
+int simplefs_verifyChecksums(int blocknum, int count, const char *buf) {
+  uint32_t *sums = simplefs_loadChecksums();
+  for (int i = 0; i < count; i++)
+    if (simplefs_crc32c(0, buf + i * BLOCKSIZE, BLOCKSIZE) !=
+        sums[blocknum + i])
+      return -1;
+  return 0;
+}
+
+// Record the checksums of `count` data blocks from `blocknum`, just written
+// from `buf`, in one write, or with `defer` set only in memory until
+// simplefs_flushChecksums. The caller holds the checksum lock
+void simplefs_storeChecksums(int blocknum, int count, const char *buf,
+                             int defer) {
+  uint32_t *sums = simplefs_loadChecksums();
+  for (int i = 0; i < count; i++)
+    sums[blocknum + i] = simplefs_crc32c(0, buf + i * BLOCKSIZE, BLOCKSIZE);
+  if (!defer) {
+    simplefs_writeChecksums(blocknum, count);
+    return;
+  }
+  if (blocknum < dirty_first)
+    dirty_first = blocknum;
+  if (blocknum + count > dirty_end)
+    dirty_end = blocknum + count;
+}
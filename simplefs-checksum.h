@@ -0,0 +1,19 @@
+// DATA BLOCK CHECKSUMS
+#ifndef SIMPLEFS_CHECKSUM_H
+#define SIMPLEFS_CHECKSUM_H
+
+#include "simplefs-disk.h"
+
+uint32_t simplefs_crc32c(uint32_t crc, const char *buf, int nbytes);
+
+// Helpers for the disk layer
+void simplefs_lockChecksums();
+void simplefs_unlockChecksums();
+void simplefs_formatChecksums();
+void simplefs_invalidateChecksums();
+void simplefs_flushChecksums();
+int simplefs_verifyChecksums(int blocknum, int count, const char *buf);
+void simplefs_storeChecksums(int blocknum, int count, const char *buf,
+                             int defer);
+
+#endif
@@ -0,0 +1,494 @@
+#include "simplefs-compress.h"
+
+#include <pthread.h>
+
+// Compressor parameters, following the LZ4 block format
+#define MIN_MATCH 4     // Shortest match worth encoding
+#define LAST_LITERALS 5 // Last bytes of a chunk are always literals
+#define MF_LIMIT 12     // Last match must start this far before the end
+#define HASH_BITS 8     // Size of the match finder table
+#define MAX_CLEN (BLOCKSIZE + BLOCKSIZE / 255 + 16) // Worst case output
+
+// Decompressed chunk cached in memory
+struct chunk_cache_t {
+  int inode_number; // -1 if the entry is empty
+  int chunk;        // index of the chunk in the file
+  int last_used;    // tick of the last access, for LRU eviction
+  int pins;         // read views using `data`, pinned entries are not evicted
+  char data[BLOCKSIZE];
+};
+
+struct chunk_cache_t chunk_cache[CHUNK_CACHE_SIZE];
+int chunk_cache_tick;
+// Guards the cache, which reads use without holding the metadata lock
+static pthread_mutex_t chunk_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Hash the 4 bytes at `p` into the match finder table
+static int lz_hash(unsigned char *p) {
+  unsigned int v;
+  memcpy(&v, p, sizeof(v));
+  return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// Write the extra bytes of a literal or match length
+static unsigned char *lz_putLength(unsigned char *op, int len) {
+  for (; len >= 255; len -= 255)
+    *op++ = 255;
+  *op++ = len;
+  return op;
+}
+
+// Compress `len` bytes of `src` into `dst` which must hold MAX_CLEN bytes.
+// Returns the compressed length
+static int lz_compress(unsigned char *src, int len, unsigned char *dst) {
+  unsigned char *ip = src, *anchor = src, *end = src + len;
+  unsigned char *op = dst;
+  int table[1 << HASH_BITS];
+  for (int i = 0; i < (1 << HASH_BITS); i++)
+    table[i] = -1;
+
+  // Inputs too short to hold a match are emitted as literals only
+  if (len > MF_LIMIT) {
+    unsigned char *mflimit = end - MF_LIMIT;
+    unsigned char *matchlimit = end - LAST_LITERALS;
+    while (ip <= mflimit) {
+      // Look up the previous position with the same 4 bytes
+      int h = lz_hash(ip);
+      int ref = table[h];
+      table[h] = ip - src;
+      if (ref < 0 || memcmp(src + ref, ip, MIN_MATCH)) {
+        ip++;
+        continue;
+      }
+
+      // Extend the match as far as allowed
+      unsigned char *match = src + ref;
+      int mlen = MIN_MATCH;
+      while (ip + mlen < matchlimit && match[mlen] == ip[mlen])
+        mlen++;
+
+      // Emit token, literals, offset and match length
+      int lit = ip - anchor;
+      unsigned char *token = op++;
+      *token = (lit >= 15 ? 15 : lit) << 4;
+      if (lit >= 15)
+        op = lz_putLength(op, lit - 15);
+      memcpy(op, anchor, lit);
+      op += lit;
+      int off = ip - match;
+      *op++ = off & 0xff;
+      *op++ = off >> 8;
+      int ml = mlen - MIN_MATCH;
+      *token |= ml >= 15 ? 15 : ml;
+      if (ml >= 15)
+        op = lz_putLength(op, ml - 15);
+
+      ip += mlen;
+      anchor = ip;
+    }
+  }
+
+  // Emit the trailing literals
+  int lit = end - anchor;
+  *op++ = (lit >= 15 ? 15 : lit) << 4;
+  if (lit >= 15)
+    op = lz_putLength(op, lit - 15);
+  memcpy(op, anchor, lit);
+  op += lit;
+  return op - dst;
+}
+
+// Compress a BLOCKSIZE chunk `src` of `len` bytes into `dst`. Returns the
+// compressed length, or BLOCKSIZE with `dst` holding a raw copy if the chunk
+// does not compress
+int simplefs_compress(char *src, int len, char *dst) {
+  unsigned char tempBuf[MAX_CLEN];
+  int clen = lz_compress((unsigned char *)src, len, tempBuf);
+  if (clen >= BLOCKSIZE) {
+    memcpy(dst, src, BLOCKSIZE);
+    return BLOCKSIZE;
+  }
+  memcpy(dst, tempBuf, clen);
+  return clen;
+}
+
+// Decompress `clen` bytes of `src` into `dst` holding at most `cap` bytes.
+// Returns the decompressed length, or -1 if `src` is malformed
+int simplefs_decompress(char *src, int clen, char *dst, int cap) {
+  unsigned char *ip = (unsigned char *)src, *iend = ip + clen;
+  char *op = dst, *oend = dst + cap;
+  while (ip < iend) {
+    int token = *ip++;
+
+    // Copy the literals
+    int lit = token >> 4;
+    if (lit == 15) {
+      int b;
+      do {
+        if (ip >= iend)
+          return -1;
+        b = *ip++;
+        lit += b;
+      } while (b == 255);
+    }
+    if (iend - ip < lit || oend - op < lit)
+      return -1;
+    memcpy(op, ip, lit);
+    op += lit;
+    ip += lit;
+
+    // The last sequence has no match
+    if (ip == iend)
+      break;
+
+    // Copy the match, which may overlap the output
+    if (iend - ip < 2)
+      return -1;
+    int off = ip[0] | ip[1] << 8;
+    ip += 2;
+    if (off == 0 || off > op - dst)
+      return -1;
+    int ml = token & 15;
+    if (ml == 15) {
+      int b;
+      do {
+        if (ip >= iend)
+          return -1;
+        b = *ip++;
+        ml += b;
+      } while (b == 255);
+    }
+    ml += MIN_MATCH;
+    if (oend - op < ml)
+      return -1;
+    for (; ml > 0; ml--, op++)
+      *op = op[-off];
+  }
+  return op - dst;
+}
+
+// Find chunk `chunk` of inode `inodenum` in the cache, NULL if missing. The
+// caller holds the chunk lock
+static struct chunk_cache_t *simplefs_lookupChunk(int inodenum, int chunk) {
+  for (int i = 0; i < CHUNK_CACHE_SIZE; i++) {
+    if (chunk_cache[i].inode_number == inodenum &&
+        chunk_cache[i].chunk == chunk) {
+      chunk_cache[i].last_used = ++chunk_cache_tick;
+      return &chunk_cache[i];
+    }
+  }
+  return NULL;
+}
+
+// Store decompressed `data` of chunk `chunk` of inode `inodenum` in the cache
+static void simplefs_cacheChunk(int inodenum, int chunk, char *data) {
+  pthread_mutex_lock(&chunk_lock);
+  struct chunk_cache_t *entry = simplefs_lookupChunk(inodenum, chunk);
+
+  // Otherwise evict the least recently used entry, nothing is cached if all
+  // of them are pinned
+  if (entry == NULL) {
+    for (int i = 0; i < CHUNK_CACHE_SIZE; i++)
+      if (chunk_cache[i].pins == 0 &&
+          (entry == NULL || chunk_cache[i].last_used < entry->last_used))
+        entry = &chunk_cache[i];
+    if (entry == NULL) {
+      pthread_mutex_unlock(&chunk_lock);
+      return;
+    }
+    entry->inode_number = inodenum;
+    entry->chunk = chunk;
+    entry->last_used = ++chunk_cache_tick;
+  }
+  memcpy(entry->data, data, BLOCKSIZE);
+  pthread_mutex_unlock(&chunk_lock);
+}
+
+// Drop cached chunks of inode `inodenum`, or of every inode if it is -1
+void simplefs_invalidateChunks(int inodenum) {
+  pthread_mutex_lock(&chunk_lock);
+  for (int i = 0; i < CHUNK_CACHE_SIZE; i++) {
+    if (inodenum != -1 && chunk_cache[i].inode_number != inodenum)
+      continue;
+    chunk_cache[i].inode_number = -1;
+    chunk_cache[i].last_used = 0;
+  }
+  pthread_mutex_unlock(&chunk_lock);
+}
+
+// Copy cached chunk `chunk` of inode `inodenum` into `buf`. Returns -1 if
+// it isn't cached
+static int simplefs_copyCachedChunk(int inodenum, int chunk, char *buf) {
+  pthread_mutex_lock(&chunk_lock);
+  struct chunk_cache_t *entry = simplefs_lookupChunk(inodenum, chunk);
+  if (entry != NULL)
+    memcpy(buf, entry->data, BLOCKSIZE);
+  pthread_mutex_unlock(&chunk_lock);
+  return entry != NULL ? 0 : -1;
+}
+
+// Decompress chunk `chunk` into `buf`, reading the blocks it is packed in.
+// Absent chunks read as zeros
+static int simplefs_loadChunk(int inodenum, struct inode_t *inode,
+                              struct chunk_t *chunks, int chunk, char *buf) {
+  if (simplefs_copyCachedChunk(inodenum, chunk, buf) == 0)
+    return 0;
+
+  memset(buf, 0, BLOCKSIZE);
+  if (chunks[chunk].length == 0)
+    return 0;
+
+  // Read the (at most two) blocks holding the chunk
+  char packed[2 * BLOCKSIZE];
+  int first = chunks[chunk].offset / BLOCKSIZE;
+  int last = (chunks[chunk].offset + chunks[chunk].length - 1) / BLOCKSIZE;
+  for (int i = first; i <= last; i++)
+    if (simplefs_readDataBlock(inode->direct_blocks[i],
+                               packed + (i - first) * BLOCKSIZE) == -1)
+      return -1;
+  char *src = packed + chunks[chunk].offset % BLOCKSIZE;
+
+  // Raw chunks are copied, the rest decompressed
+  if (chunks[chunk].length == BLOCKSIZE)
+    memcpy(buf, src, BLOCKSIZE);
+  else if (simplefs_decompress(src, chunks[chunk].length, buf, BLOCKSIZE) !=
+           BLOCKSIZE)
+    return -1;
+
+  simplefs_cacheChunk(inodenum, chunk, buf);
+  return 0;
+}
+
+// Read decompressed chunk `chunk` of inode `inodenum` into `buf`
+int simplefs_readChunk(int inodenum, int chunk, char *buf) {
+  struct inode_t inode;
+  struct chunk_t chunks[MAX_FILE_SIZE];
+  simplefs_readInode(inodenum, &inode);
+  simplefs_readChunkMap(inodenum, chunks);
+  return simplefs_loadChunk(inodenum, &inode, chunks, chunk, buf);
+}
+
+// Pin decompressed chunk `chunk` of inode `inodenum` in the cache, pointing
+// `data` at it. Returns the cache entry to pass to simplefs_unpinChunk, -1 if
+// the chunk is corrupt or every entry is pinned
+int simplefs_pinChunk(int inodenum, struct inode_t *inode, int chunk,
+                      const char **data) {
+  pthread_mutex_lock(&chunk_lock);
+  struct chunk_cache_t *entry = simplefs_lookupChunk(inodenum, chunk);
+  if (entry == NULL) {
+    pthread_mutex_unlock(&chunk_lock);
+    char tempBlockBuf[BLOCKSIZE];
+    struct chunk_t chunks[MAX_FILE_SIZE];
+    simplefs_readChunkMap(inodenum, chunks);
+    if (simplefs_loadChunk(inodenum, inode, chunks, chunk, tempBlockBuf) == -1)
+      return -1;
+    pthread_mutex_lock(&chunk_lock);
+    entry = simplefs_lookupChunk(inodenum, chunk);
+    if (entry == NULL) {
+      pthread_mutex_unlock(&chunk_lock);
+      return -1;
+    }
+  }
+  entry->pins++;
+  *data = entry->data;
+  pthread_mutex_unlock(&chunk_lock);
+  return entry - chunk_cache;
+}
+
+// Release a cache entry pinned by simplefs_pinChunk
+void simplefs_unpinChunk(int entry) {
+  assert(entry >= 0 && entry < CHUNK_CACHE_SIZE);
+  pthread_mutex_lock(&chunk_lock);
+  assert(chunk_cache[entry].pins > 0);
+  chunk_cache[entry].pins--;
+  pthread_mutex_unlock(&chunk_lock);
+}
+
+// read `nbytes` at `offset` of compressed inode `inodenum` into `buf`
+int simplefs_readCompressed(int inodenum, struct inode_t *inode, int offset,
+                            char *buf, int nbytes) {
+  struct chunk_t chunks[MAX_FILE_SIZE];
+  int have_chunks = 0;
+  char tempBlockBuf[BLOCKSIZE];
+  int tempset = 0;
+
+  // Iterate over the chunks covering the range
+  for (int i = offset / BLOCKSIZE; tempset < nbytes; i++) {
+    int ls = offset + tempset - i * BLOCKSIZE;
+    int len = BLOCKSIZE - ls;
+    if (len > nbytes - tempset)
+      len = nbytes - tempset;
+
+    // Serve from the cache, reading the chunk map only on a miss
+    if (simplefs_copyCachedChunk(inodenum, i, tempBlockBuf) == -1) {
+      if (!have_chunks) {
+        simplefs_readChunkMap(inodenum, chunks);
+        have_chunks = 1;
+      }
+      if (simplefs_loadChunk(inodenum, inode, chunks, i, tempBlockBuf) == -1)
+        return -1;
+    }
+    memcpy(buf + tempset, tempBlockBuf + ls, len);
+    tempset += len;
+  }
+  return 0;
+}
+
+// write `nbytes` of `buf` at `offset` of compressed inode `inodenum`, then
+// repack the chunks into the fewest data blocks
+int simplefs_writeCompressed(int inodenum, struct inode_t *inode, int offset,
+                             char *buf, int nbytes) {
+  struct chunk_t chunks[MAX_FILE_SIZE], new_chunks[MAX_FILE_SIZE];
+  char packed[MAX_FILE_SIZE * BLOCKSIZE], new_packed[MAX_FILE_SIZE * BLOCKSIZE];
+  // Patched chunks, cached only once they are on disk
+  char plain[MAX_FILE_SIZE][BLOCKSIZE];
+  char patched[MAX_FILE_SIZE] = {0};
+  simplefs_readChunkMap(inodenum, chunks);
+  memset(new_packed, 0, sizeof(new_packed));
+
+  // Read the currently packed blocks
+  int old_blocks = 0;
+  while (old_blocks < MAX_FILE_SIZE &&
+         inode->direct_blocks[old_blocks] != -1) {
+    if (simplefs_readDataBlock(inode->direct_blocks[old_blocks],
+                               packed + old_blocks * BLOCKSIZE) == -1)
+      return -1;
+    old_blocks++;
+  }
+
+  // Rebuild the packed stream, recompressing only the chunks written to
+  int new_len = 0;
+  int end = offset + nbytes;
+  for (int i = 0; i < MAX_FILE_SIZE; i++) {
+    new_chunks[i].offset = new_len;
+    new_chunks[i].length = 0;
+    if (end <= i * BLOCKSIZE || offset >= (i + 1) * BLOCKSIZE) {
+      // Untouched chunk keeps its compressed bytes
+      if (chunks[i].length == 0)
+        continue;
+      memcpy(new_packed + new_len, packed + chunks[i].offset,
+             chunks[i].length);
+      new_chunks[i].length = chunks[i].length;
+    } else {
+      // Patch the decompressed chunk and compress it again
+      if (simplefs_loadChunk(inodenum, inode, chunks, i, plain[i]) == -1)
+        return -1;
+      int ls = offset > i * BLOCKSIZE ? offset - i * BLOCKSIZE : 0;
+      int rs = end < (i + 1) * BLOCKSIZE ? (i + 1) * BLOCKSIZE - end : 0;
+      memcpy(plain[i] + ls, buf + i * BLOCKSIZE + ls - offset,
+             BLOCKSIZE - ls - rs);
+      new_chunks[i].length =
+          simplefs_compress(plain[i], BLOCKSIZE, new_packed + new_len);
+      patched[i] = 1;
+    }
+    new_len += new_chunks[i].length;
+  }
+
+  // Kept blocks about to change get their own copy if shared. The old bytes
+  // are copied too, so the file still reads right if the disk fills up
+  int new_blocks = (new_len + BLOCKSIZE - 1) / BLOCKSIZE;
+  for (int i = 0; i < old_blocks && i < new_blocks; i++) {
+    if (!memcmp(packed + i * BLOCKSIZE, new_packed + i * BLOCKSIZE, BLOCKSIZE))
+      continue;
+    int blocknum = simplefs_unshareDataBlock(
+        inodenum, inode->direct_blocks[i], inode->direct_blocks[i], 1);
+    if (blocknum == -1) {
+      simplefs_writeInode(inodenum, inode);
+      simplefs_invalidateChunks(inodenum);
+      return -1;
+    }
+    inode->direct_blocks[i] = blocknum;
+  }
+
+  // Allocate the extra blocks needed, reverting if the disk is full
+  for (int i = old_blocks; i < new_blocks; i++) {
+    int goal = i > 0 ? inode->direct_blocks[i - 1] + 1 : 0;
+    inode->direct_blocks[i] = simplefs_allocDataBlockNear(inodenum, goal);
+    if (inode->direct_blocks[i] != -1)
+      continue;
+    for (i--; i >= old_blocks; i--) {
+      simplefs_freeDataBlock(inode->direct_blocks[i]);
+      inode->direct_blocks[i] = -1;
+    }
+    simplefs_writeInode(inodenum, inode);
+    simplefs_invalidateChunks(inodenum);
+    return -1;
+  }
+
+  // Free the blocks no longer needed
+  for (int i = new_blocks; i < old_blocks; i++) {
+    simplefs_freeDataBlock(inode->direct_blocks[i]);
+    inode->direct_blocks[i] = -1;
+  }
+
+  // Write only the blocks whose packed bytes changed
+  for (int i = 0; i < new_blocks; i++) {
+    if (i < old_blocks &&
+        !memcmp(packed + i * BLOCKSIZE, new_packed + i * BLOCKSIZE, BLOCKSIZE))
+      continue;
+    simplefs_writeDataBlock(inode->direct_blocks[i],
+                            new_packed + i * BLOCKSIZE);
+  }
+
+  // Update the file size, inode and chunk map
+  if (inode->file_size < end)
+    inode->file_size = end;
+  simplefs_writeInode(inodenum, inode);
+  simplefs_writeChunkMap(inodenum, new_chunks);
+  for (int i = 0; i < MAX_FILE_SIZE; i++)
+    if (patched[i])
+      simplefs_cacheChunk(inodenum, i, plain[i]);
+  return 0;
+}
+
+// Cut compressed inode `inodenum` down to `size` bytes. Chunks past it sit at
+// the end of the packed blocks, so dropping them frees the trailing blocks
+int simplefs_truncateCompressed(int inodenum, struct inode_t *inode,
+                                int size) {
+  struct chunk_t chunks[MAX_FILE_SIZE];
+  simplefs_readChunkMap(inodenum, chunks);
+
+  // Zero the tail of the last kept chunk so growing again reads zeros
+  int last = size / BLOCKSIZE;
+  if (size < inode->file_size && size % BLOCKSIZE && chunks[last].length) {
+    char zeros[BLOCKSIZE] = {0};
+    int end = (last + 1) * BLOCKSIZE;
+    if (end > inode->file_size)
+      end = inode->file_size;
+    if (simplefs_writeCompressed(inodenum, inode, size, zeros, end - size) ==
+        -1)
+      return -1;
+    simplefs_readChunkMap(inodenum, chunks);
+  }
+
+  // Drop the chunks past the new end and find the packed length left
+  int keep = (size + BLOCKSIZE - 1) / BLOCKSIZE;
+  int new_len = 0;
+  for (int i = 0; i < MAX_FILE_SIZE; i++) {
+    if (i >= keep) {
+      chunks[i].offset = 0;
+      chunks[i].length = 0;
+    } else if (chunks[i].length &&
+               new_len < chunks[i].offset + chunks[i].length) {
+      new_len = chunks[i].offset + chunks[i].length;
+    }
+  }
+
+  // Free the packed blocks no longer needed in one go
+  int blocknums[MAX_FILE_SIZE];
+  int count = 0;
+  for (int i = (new_len + BLOCKSIZE - 1) / BLOCKSIZE; i < MAX_FILE_SIZE; i++) {
+    if (inode->direct_blocks[i] == -1)
+      continue;
+    blocknums[count++] = inode->direct_blocks[i];
+    inode->direct_blocks[i] = -1;
+  }
+  simplefs_freeDataBlocks(blocknums, count);
+  simplefs_invalidateChunks(inodenum);
+
+  // Update the file size, inode and chunk map
+  inode->file_size = size;
+  simplefs_writeInode(inodenum, inode);
+  simplefs_writeChunkMap(inodenum, chunks);
+  return 0;
+}
@@ -0,0 +1,23 @@
+// COMPRESSED FILE DATA
+#ifndef SIMPLEFS_COMPRESS_H
+#define SIMPLEFS_COMPRESS_H
+
+#include "simplefs-disk.h"
+
+#define CHUNK_CACHE_SIZE 8 // Decompressed chunks kept in memory
+
+int simplefs_compress(char *src, int len, char *dst);
+int simplefs_decompress(char *src, int clen, char *dst, int cap);
+int simplefs_readChunk(int inodenum, int chunk, char *buf);
+int simplefs_pinChunk(int inodenum, struct inode_t *inode, int chunk,
+                      const char **data);
+void simplefs_unpinChunk(int entry);
+void simplefs_invalidateChunks(int inodenum);
+int simplefs_readCompressed(int inodenum, struct inode_t *inode, int offset,
+                            char *buf, int nbytes);
+int simplefs_writeCompressed(int inodenum, struct inode_t *inode, int offset,
+                             char *buf, int nbytes);
+int simplefs_truncateCompressed(int inodenum, struct inode_t *inode,
+                                int size);
+
+#endif
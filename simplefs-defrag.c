@@ -0,0 +1,157 @@
+#include "simplefs-defrag.h"
+#include "simplefs-view.h"
+
+// FEATURE_* flags the disk was formatted with
+extern int DISK_FEATURES;
+// Set once a data block may be shared
+extern int DISK_SHARING;
+
+// Number of runs of consecutive blocks in `blocknums`
+static int simplefs_countExtents(int *blocknums, int count) {
+  int extents = 0;
+  for (int i = 0; i < count; i++)
+    if (i == 0 || blocknums[i] != blocknums[i - 1] + 1)
+      extents++;
+  return extents;
+}
+
+// Move the blocks of inode `inodenum` into one run of consecutive blocks,
+// placed as low on the disk as possible. If no free run is long enough, the
+// part of the file whose move removes most extents goes to the longest run
+// instead. Holes stay holes. The inode is switched to the new blocks with a
+// single write once they hold the data, so open handles keep working. Files
+// sharing blocks with clones or snapshots are left alone, moving them would
+// split the sharing. The caller holds the metadata lock. Returns the number
+// of blocks moved, -1 if one fails its checksum or the file's mappings can't
+// be made private
+static int simplefs_defragInode(int inodenum, struct inode_t *inode) {
+  int blocknums[MAX_FILE_SIZE], index[MAX_FILE_SIZE];
+  int count = 0;
+  for (int i = 0; i < MAX_FILE_SIZE; i++) {
+    if (inode->direct_blocks[i] == -1)
+      continue;
+    if (DISK_SHARING && simplefs_dataBlockRefs(inode->direct_blocks[i]) > 1)
+      return 0;
+    index[count] = i;
+    blocknums[count++] = inode->direct_blocks[i];
+  }
+  int extents = simplefs_countExtents(blocknums, count);
+  if (count == 0)
+    return 0;
+
+  // An unfragmented file only moves down into a lower free run
+  int limit = extents == 1 ? blocknums[0] : NUM_DATA_BLOCKS;
+  int first = 0, len = count;
+  int start = simplefs_allocDataRun(count, limit);
+
+  // Otherwise take the longest free run for part of a fragmented file
+  while (start == -1 && extents > 1 && --len >= 2)
+    start = simplefs_allocDataRun(len, NUM_DATA_BLOCKS);
+  if (start == -1)
+    return 0;
+  if (len < count) {
+    int best = extents;
+    for (int i = 0; i + len <= count; i++) {
+      int moved[MAX_FILE_SIZE];
+      memcpy(moved, blocknums, sizeof(moved));
+      for (int j = 0; j < len; j++)
+        moved[i + j] = start + j;
+      if (simplefs_countExtents(moved, count) < best) {
+        best = simplefs_countExtents(moved, count);
+        first = i;
+      }
+    }
+    if (best == extents) {
+      for (int j = 0; j < len; j++)
+        blocknums[j] = start + j;
+      simplefs_freeDataBlocks(blocknums, len);
+      return 0;
+    }
+  }
+
+  // Mappings of the file become private, the old blocks are freed. Then
+  // copy the data over with one read per old extent and one write. A block
+  // failing its checksum gives the new run back and leaves the file alone
+  char tempBuf[MAX_FILE_SIZE * BLOCKSIZE];
+  int ret = simplefs_privatizeMappings(inodenum);
+  for (int i = 0, run; i < len && ret == 0; i += run) {
+    for (run = 1; i + run < len; run++)
+      if (blocknums[first + i + run] != blocknums[first + i] + run)
+        break;
+    ret = simplefs_readDataBlocks(blocknums[first + i], run,
+                                  tempBuf + i * BLOCKSIZE);
+  }
+  if (ret == -1) {
+    for (int j = 0; j < len; j++)
+      blocknums[j] = start + j;
+    simplefs_freeDataBlocks(blocknums, len);
+    return -1;
+  }
+  simplefs_writeDataBlocks(start, len, tempBuf);
+
+  // Switch the inode over, then release the old blocks together
+  for (int i = 0; i < len; i++)
+    inode->direct_blocks[index[first + i]] = start + i;
+  simplefs_writeInode(inodenum, inode);
+  simplefs_freeDataBlocks(blocknums + first, len);
+  return len;
+}
+
+// Defragment files and compact free space towards the end of the disk,
+// moving at most `max_blocks` blocks so foreground I/O can run between calls.
+// Files may stay open meanwhile. Returns the number of blocks moved, 0 once
+// there is nothing left to do, -1 if a block fails its checksum or mappings
+// of a file can't be made private
+int simplefs_defrag(int max_blocks) {
+  // Log-structured disks are cleaned by simplefs_clean instead
+  if (DISK_FEATURES & FEATURE_LOG)
+    return 0;
+
+  struct inode_t *inode = (struct inode_t *)malloc(sizeof(struct inode_t));
+  int moved = 0;
+  int done[NUM_INODES] = {0};
+
+  // Visit files in order of their first block, so lower ones settle first
+  while (moved < max_blocks) {
+    int next = -1, next_first = NUM_DATA_BLOCKS;
+    for (int i = 0; i < NUM_INODES; i++) {
+      if (done[i])
+        continue;
+      simplefs_readInode(i, inode);
+      if (inode->status != INODE_IN_USE)
+        continue;
+      for (int j = 0; j < MAX_FILE_SIZE; j++) {
+        if (inode->direct_blocks[j] == -1 ||
+            inode->direct_blocks[j] >= next_first)
+          continue;
+        next = i;
+        next_first = inode->direct_blocks[j];
+      }
+    }
+    if (next == -1)
+      break;
+    done[next] = 1;
+
+    // Leave files that don't fit in what is left of the budget. The inode
+    // is held from being read to being written back, so writes to the file
+    // meanwhile are not undone
+    simplefs_lockMetadata();
+    simplefs_readInode(next, inode);
+    int count = 0;
+    for (int j = 0; j < MAX_FILE_SIZE; j++)
+      count += inode->direct_blocks[j] != -1;
+    int fits = moved + count <= max_blocks;
+    int ret = fits ? simplefs_defragInode(next, inode) : 0;
+    simplefs_unlockMetadata();
+    if (ret == -1) {
+      free(inode); // Free malloced data
+      return -1;
+    }
+    moved += ret;
+    if (!fits)
+      break;
+  }
+
+  free(inode); // Free malloced data
+  return moved;
+}
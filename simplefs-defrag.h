@@ -0,0 +1,9 @@
+// ONLINE DEFRAGMENTATION
+#ifndef SIMPLEFS_DEFRAG_H
+#define SIMPLEFS_DEFRAG_H
+
+#include "simplefs-disk.h"
+
+int simplefs_defrag(int max_blocks);
+
+#endif
@@ -0,0 +1,289 @@
+#include "simplefs-dir.h"
+#include "simplefs-ops.h"
+
+#define DCACHE_SIZE 32 // Entries of the dentry cache
+#define DIR_SLOTS (MAX_FILE_SIZE * DIRENTS_PER_BLOCK)
+
+// Name looked up in a directory, kept until the entry is removed or the
+// disk is formatted or mounted again
+struct dentry_t {
+  int used;
+  int parent; // directory inode
+  unsigned int hash;
+  int inode_number;
+  char name[DIR_NAME_LEN + 1];
+};
+static struct dentry_t dcache[DCACHE_SIZE];
+
+// 32-bit FNV-1a hash of `name`
+static unsigned int simplefs_nameHash(const char *name) {
+  unsigned int hash = 2166136261u;
+  for (; *name; name++)
+    hash = (hash ^ (unsigned char)*name) * 16777619u;
+  return hash;
+}
+
+// Cache slot for `name` in directory `dirnum`
+static struct dentry_t *simplefs_dentrySlot(int dirnum, unsigned int hash) {
+  return &dcache[(hash ^ (unsigned int)dirnum * 2654435761u) % DCACHE_SIZE];
+}
+
+// Forget every cached name
+void simplefs_invalidateDentries() { memset(dcache, 0, sizeof(dcache)); }
+
+// read block `b` of directory `dirnum` into `entries`. Blocks past the end
+// of the directory read as empty
+static void simplefs_readDirBlock(int dirnum, struct inode_t *dir, int b,
+                                  struct dirent_t *entries) {
+  if ((b + 1) * BLOCKSIZE > dir->file_size) {
+    memset(entries, 0, BLOCKSIZE);
+    return;
+  }
+  simplefs_readFile(dirnum, dir, b * BLOCKSIZE, (char *)entries, BLOCKSIZE);
+}
+
+// Find `name` in directory `dirnum`, reading its slots from the block the
+// name hashes to until an empty one. Returns the slot, -1 if it is missing.
+// With `free_slot` set, also the first slot a new entry could take, -1 if
+// the directory is full
+static int simplefs_findEntry(int dirnum, struct inode_t *dir, char *name,
+                              unsigned int hash, struct dirent_t *found,
+                              int *free_slot) {
+  struct dirent_t entries[DIRENTS_PER_BLOCK];
+  int first = hash % MAX_FILE_SIZE * DIRENTS_PER_BLOCK;
+  int loaded = -1;
+  if (free_slot)
+    *free_slot = -1;
+
+  for (int n = 0; n < DIR_SLOTS; n++) {
+    int slot = (first + n) % DIR_SLOTS;
+    if (slot / DIRENTS_PER_BLOCK != loaded) {
+      loaded = slot / DIRENTS_PER_BLOCK;
+      simplefs_readDirBlock(dirnum, dir, loaded, entries);
+    }
+    struct dirent_t *entry = &entries[slot % DIRENTS_PER_BLOCK];
+    if (entry->status != DIRENT_IN_USE && free_slot && *free_slot == -1)
+      *free_slot = slot;
+    if (entry->status == DIRENT_EMPTY)
+      return -1;
+    if (entry->status == DIRENT_IN_USE && entry->hash == hash &&
+        !strncmp(entry->name, name, DIR_NAME_LEN)) {
+      memcpy(found, entry, sizeof(struct dirent_t));
+      return slot;
+    }
+  }
+  return -1;
+}
+
+// Inode named `name` in directory `dirnum`, -1 if there is none. Taking the
+// metadata lock drops the cache if other attached processes changed the disk
+static int simplefs_dirLookup(int dirnum, char *name) {
+  simplefs_lockMetadata();
+  unsigned int hash = simplefs_nameHash(name);
+  struct dentry_t *dentry = simplefs_dentrySlot(dirnum, hash);
+  if (dentry->used && dentry->parent == dirnum && dentry->hash == hash &&
+      !strcmp(dentry->name, name)) {
+    simplefs_unlockMetadata();
+    return dentry->inode_number;
+  }
+
+  struct inode_t *dir = (struct inode_t *)malloc(sizeof(struct inode_t));
+  struct dirent_t entry;
+  simplefs_readInode(dirnum, dir);
+  int slot = simplefs_findEntry(dirnum, dir, name, hash, &entry, NULL);
+  free(dir); // Free malloced data
+
+  // Remember it for the next lookup
+  if (slot != -1) {
+    dentry->used = 1;
+    dentry->parent = dirnum;
+    dentry->hash = hash;
+    dentry->inode_number = entry.inode_number;
+    strcpy(dentry->name, name);
+  }
+  simplefs_unlockMetadata();
+  return slot == -1 ? -1 : entry.inode_number;
+}
+
+// Point slot `slot` of directory `dirnum` at `entry`
+static int simplefs_writeEntry(int dirnum, int slot, struct dirent_t *entry) {
+  struct inode_t *dir = (struct inode_t *)malloc(sizeof(struct inode_t));
+  simplefs_readInode(dirnum, dir);
+
+  // Grow the directory by whole blocks so every slot reads back
+  int ret;
+  int end = (slot / DIRENTS_PER_BLOCK + 1) * BLOCKSIZE;
+  if (dir->file_size < end) {
+    char tempBuf[BLOCKSIZE];
+    memset(tempBuf, 0, BLOCKSIZE);
+    memcpy(tempBuf + slot % DIRENTS_PER_BLOCK * sizeof(struct dirent_t),
+           entry, sizeof(struct dirent_t));
+    ret = simplefs_writeFile(dirnum, dir, end - BLOCKSIZE, tempBuf, BLOCKSIZE);
+  } else {
+    ret = simplefs_writeFile(dirnum, dir, slot * sizeof(struct dirent_t),
+                             (char *)entry, sizeof(struct dirent_t));
+  }
+  free(dir); // Free malloced data
+  return ret;
+}
+
+// Split `path` into the directory holding its last component and the
+// component itself, copied to `leaf`. The parent is -1 for the root.
+// Returns -1 if a directory on the way is missing or a name is too long
+static int simplefs_walkPath(char *path, int *parent, char *leaf) {
+  *parent = -1;
+  while (*path == '/')
+    path++;
+  for (;;) {
+    // Copy the next component
+    int len = strcspn(path, "/");
+    if (len == 0 || len > DIR_NAME_LEN)
+      return -1;
+    memcpy(leaf, path, len);
+    leaf[len] = '\0';
+    path += len;
+    while (*path == '/')
+      path++;
+    if (*path == '\0')
+      return 0;
+
+    // Step into it, it has to be a directory
+    int inodenum = *parent == -1 ? simplefs_findInode(leaf)
+                                 : simplefs_dirLookup(*parent, leaf);
+    if (inodenum == -1 || !(simplefs_inodeFlags(inodenum) & INODE_FLAG_DIR))
+      return -1;
+    *parent = inodenum;
+  }
+}
+
+// Inode `path` refers to, names without a '/' are looked up at the root.
+// Returns -1 if there is none
+int simplefs_lookupPath(char *path) {
+  if (!strchr(path, '/'))
+    return simplefs_findInode(path);
+  int parent;
+  char leaf[DIR_NAME_LEN + 1];
+  if (simplefs_walkPath(path, &parent, leaf) == -1)
+    return -1;
+  return parent == -1 ? simplefs_findInode(leaf)
+                      : simplefs_dirLookup(parent, leaf);
+}
+
+// Create an empty inode with INODE_FLAG_* `flags` at `path`, which must not
+// exist yet. Names at the root keep the MAX_NAME_STRLEN limit, names in a
+// directory go up to DIR_NAME_LEN bytes. Returns the inode number, -1 if the
+// parent is missing, the name too long or there is no room
+int simplefs_createEntry(char *path, int flags) {
+  int parent;
+  char leaf[DIR_NAME_LEN + 1];
+  if (simplefs_walkPath(path, &parent, leaf) == -1)
+    return -1;
+  if (parent == -1 && strlen(leaf) > MAX_NAME_STRLEN)
+    return -1;
+
+  // Find a slot in the parent first, so a full directory costs no inode
+  unsigned int hash = simplefs_nameHash(leaf);
+  struct dirent_t entry;
+  int slot = -1;
+  if (parent != -1) {
+    struct inode_t *dir = (struct inode_t *)malloc(sizeof(struct inode_t));
+    simplefs_readInode(parent, dir);
+    simplefs_findEntry(parent, dir, leaf, hash, &entry, &slot);
+    free(dir); // Free malloced data
+    if (slot == -1)
+      return -1;
+  }
+
+  // Allocate inode if it is feasible
+  int inodenum = simplefs_allocInode();
+  if (inodenum == -1)
+    return -1;
+
+  // Setup the inode. Entries of directories only keep the first
+  // MAX_NAME_STRLEN bytes of their name there, for listings and fsck, the
+  // whole name is in the directory entry
+  struct inode_t *inode = (struct inode_t *)malloc(sizeof(struct inode_t));
+  memset(inode, 0, sizeof(struct inode_t));
+  inode->status = INODE_IN_USE;
+  inode->file_size = 0;
+  for (int i = 0; i < MAX_FILE_SIZE; i++)
+    inode->direct_blocks[i] = -1;
+  memcpy(inode->name, leaf, strnlen(leaf, MAX_NAME_STRLEN));
+  inode->flags = flags | (parent != -1 ? INODE_FLAG_CHILD : 0);
+  simplefs_writeInode(inodenum, inode);
+  free(inode); // Free malloced data
+
+  // Link it into the parent
+  if (parent != -1) {
+    memset(&entry, 0, sizeof(entry));
+    entry.hash = hash;
+    entry.inode_number = inodenum;
+    entry.status = DIRENT_IN_USE;
+    memcpy(entry.name, leaf, strnlen(leaf, DIR_NAME_LEN));
+    if (simplefs_writeEntry(parent, slot, &entry) == -1) {
+      simplefs_freeInode(inodenum);
+      return -1;
+    }
+  }
+  return inodenum;
+}
+
+// Remove the entry for `path` from its directory, if it is in one
+void simplefs_unlinkPath(char *path) {
+  int parent;
+  char leaf[DIR_NAME_LEN + 1];
+  if (!strchr(path, '/') || simplefs_walkPath(path, &parent, leaf) == -1 ||
+      parent == -1)
+    return;
+
+  unsigned int hash = simplefs_nameHash(leaf);
+  struct inode_t *dir = (struct inode_t *)malloc(sizeof(struct inode_t));
+  struct dirent_t entry;
+  simplefs_readInode(parent, dir);
+  int slot = simplefs_findEntry(parent, dir, leaf, hash, &entry, NULL);
+  free(dir); // Free malloced data
+  if (slot == -1)
+    return;
+
+  // Lookups have to go on past the slot, so it is only marked deleted
+  entry.status = DIRENT_DELETED;
+  simplefs_writeEntry(parent, slot, &entry);
+  struct dentry_t *dentry = simplefs_dentrySlot(parent, hash);
+  if (dentry->used && dentry->parent == parent && !strcmp(dentry->name, leaf))
+    dentry->used = 0;
+}
+
+// 1 if directory `dirnum` has no entries in use
+int simplefs_dirEmpty(int dirnum) {
+  struct inode_t *dir = (struct inode_t *)malloc(sizeof(struct inode_t));
+  struct dirent_t entries[DIRENTS_PER_BLOCK];
+  simplefs_readInode(dirnum, dir);
+  int empty = 1;
+  for (int b = 0; b < MAX_FILE_SIZE && empty; b++) {
+    simplefs_readDirBlock(dirnum, dir, b, entries);
+    for (int k = 0; k < DIRENTS_PER_BLOCK; k++)
+      if (entries[k].status == DIRENT_IN_USE)
+        empty = 0;
+  }
+  free(dir); // Free malloced data
+  return empty;
+}
+
+// Create directory `path`. Returns its inode number, -1 if it exists, the
+// parent is missing or there is no room
+int simplefs_mkdir(char *path) {
+  if (simplefs_lookupPath(path) != -1)
+    return -1;
+  return simplefs_createEntry(path, INODE_FLAG_DIR);
+}
+
+// Remove directory `path` if it is empty. Returns 0, -1 if it is missing,
+// not a directory or not empty
+int simplefs_rmdir(char *path) {
+  int inodenum = simplefs_lookupPath(path);
+  if (inodenum == -1 || !(simplefs_inodeFlags(inodenum) & INODE_FLAG_DIR) ||
+      !simplefs_dirEmpty(inodenum))
+    return -1;
+  simplefs_delete(path);
+  return 0;
+}
@@ -0,0 +1,17 @@
+// DIRECTORIES
+#ifndef SIMPLEFS_DIR_H
+#define SIMPLEFS_DIR_H
+
+#include "simplefs-disk.h"
+
+int simplefs_mkdir(char *path);
+int simplefs_rmdir(char *path);
+
+// Helpers for the file operations
+int simplefs_lookupPath(char *path);
+int simplefs_createEntry(char *path, int flags);
+void simplefs_unlinkPath(char *path);
+int simplefs_dirEmpty(int dirnum);
+void simplefs_invalidateDentries();
+
+#endif
@@ -1,30 +1,180 @@
 #include "simplefs-disk.h"
+#include "simplefs-checksum.h"
+#include "simplefs-compress.h"
+#include "simplefs-dir.h"
+#include "simplefs-shared.h"
+#include "simplefs-stripe.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 // pointer to simplefs.txt
 int DISK_FD;
+// FEATURE_* flags the disk was formatted with
+int DISK_FEATURES;
+// Image files the data blocks are striped over, 1 if not striped
+int STRIPE_MEMBERS = 1;
+// Consecutive data blocks stored on one member before moving to the next
+int STRIPE_UNIT = 1;
+// Blocks reserved ahead for each appending inode, 0 to disable windows
+int RESERVATION_WINDOW;
+// Per inode window of free blocks kept for its next allocations
+struct window_t alloc_window[NUM_INODES];
+// Set once a data block may be shared, so writes check for copy-on-write
+int DISK_SHARING;
 // Array for storing opened files
 struct filehandle_t file_handle_array[MAX_OPEN_FILES];
+// FEATURE_LOG: next data block the log writes to
+int LOG_HEAD;
+// FEATURE_LOG: segment the cleaner is emptying, the log skips it, -1 if none
+int LOG_CLEANING;
+
+// Superblock and inode table held in memory while a batch runs
+struct metadata_batch_t {
+  int active;
+  int superblock_dirty;
+  char dirty[NUM_INODE_BLOCKS]; // inode blocks changed since the batch began
+  char metadata[DATA_BLOCK_START * BLOCKSIZE];
+};
+static struct metadata_batch_t batch;
+
+// Last block of a file being appended to, with its inode, written back once
+// the block fills or someone else reads the inode
+struct append_tail_t {
+  int inode_number; // -1 if nothing is cached
+  int dirty;        // appended to since last written back
+  struct inode_t inode;
+  char block[BLOCKSIZE];
+};
+static struct append_tail_t tail = {.inode_number = -1};
+
+// In-core inode table of this process, and the one in use, which is in
+// shared memory while attached to other processes
+static struct inode_table_t local_inode_table;
+static struct inode_table_t *inode_table = &local_inode_table;
+
+// Held while the free maps are read and written back, so the background
+// reclaimer never interleaves with an allocation. Recursive, calls nest.
+// Processes attached to a shared segment take its lock instead
+static pthread_mutex_t metadata_lock;
+static pthread_once_t metadata_lock_once = PTHREAD_ONCE_INIT;
+
+static void simplefs_initMetadataLock() {
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(&metadata_lock, &attr);
+  pthread_mutexattr_destroy(&attr);
+}
+
+void simplefs_lockMetadata() {
+  if (simplefs_lockShared() == 0)
+    return;
+  pthread_once(&metadata_lock_once, simplefs_initMetadataLock);
+  pthread_mutex_lock(&metadata_lock);
+}
+
+void simplefs_unlockMetadata() {
+  if (simplefs_unlockShared() == 0)
+    return;
+  pthread_mutex_unlock(&metadata_lock);
+}
+
+// read `nbytes` of the metadata at byte `offset` of the disk into `buf`, from
+// the shared copy while attached
+static void simplefs_readMetadata(int offset, char *buf, int nbytes) {
+  if (simplefs_lockShared() == 0) {
+    memcpy(buf, simplefs_sharedMetadata() + offset, nbytes);
+    simplefs_unlockShared();
+    return;
+  }
+  int ret = pread(DISK_FD, buf, nbytes, offset);
+  assert(ret == nbytes);
+}
+
+// write `nbytes` of `buf` to the metadata at byte `offset` of the disk, and
+// to the shared copy while attached
+static void simplefs_writeMetadata(int offset, char *buf, int nbytes) {
+  int shared = simplefs_lockShared() == 0;
+  int ret = pwrite(DISK_FD, buf, nbytes, offset);
+  assert(ret == nbytes);
+  if (shared) {
+    memcpy(simplefs_sharedMetadata() + offset, buf, nbytes);
+    simplefs_touchShared();
+    simplefs_unlockShared();
+  }
+}
 
 // Helper function to read superblock from disk into superblock_t structure
 void simplefs_readSuperBlock(struct superblock_t *superblock) {
+  if (batch.active) {
+    memcpy(superblock, batch.metadata, sizeof(struct superblock_t));
+    return;
+  }
   char tempBuf[BLOCKSIZE];
-  lseek(DISK_FD, 0, SEEK_SET);
-  int ret = read(DISK_FD, tempBuf, BLOCKSIZE);
-  assert(ret == BLOCKSIZE);
+  simplefs_readMetadata(0, tempBuf, BLOCKSIZE);
   memcpy(superblock, tempBuf, sizeof(struct superblock_t));
 }
 
 // Helper function to write superblock from superblock_t structure to disk
 void simplefs_writeSuperBlock(struct superblock_t *superblock) {
+  if (batch.active) {
+    memcpy(batch.metadata, superblock, sizeof(struct superblock_t));
+    batch.superblock_dirty = 1;
+    return;
+  }
   char tempBuf[BLOCKSIZE];
   memcpy(tempBuf, superblock, sizeof(struct superblock_t));
-  lseek(DISK_FD, 0, SEEK_SET);
-  int ret = write(DISK_FD, tempBuf, BLOCKSIZE);
-  assert(ret == BLOCKSIZE);
+  simplefs_writeMetadata(0, tempBuf, BLOCKSIZE);
+}
+
+// FEATURE_LOG: write `blocknum` back as the head of the log. Inodes live in
+// the log on these disks, so it takes the place of the first inode block
+static void simplefs_writeLogHead(int blocknum) {
+  char tempBuf[sizeof(int)];
+  memcpy(tempBuf, &blocknum, sizeof(int));
+  simplefs_writeMetadata(BLOCKSIZE * LOG_HEAD_START, tempBuf, sizeof(int));
+}
+
+// FEATURE_LOG: the head of the log written back last, moved on past the
+// blocks taken since in its segment
+static int simplefs_readLogHead(struct superblock_t *superblock) {
+  char tempBuf[sizeof(int)];
+  int head;
+  simplefs_readMetadata(BLOCKSIZE * LOG_HEAD_START, tempBuf, sizeof(int));
+  memcpy(&head, tempBuf, sizeof(int));
+  if (head < 0 || head >= NUM_DATA_BLOCKS)
+    return 0;
+  while (head % SEGMENT_BLOCKS != SEGMENT_BLOCKS - 1 &&
+         superblock->datablock_freelist[head] != DATA_BLOCK_FREE)
+    head++;
+  return head;
 }
 
 // Format filesystem and initialise superblock and inodes with default values
-void simplefs_formatDisk() {
+void simplefs_formatDisk() { simplefs_formatDiskWithFeatures(0); }
+
+// Format filesystem with the optional FEATURE_* flags in `features` enabled
+void simplefs_formatDiskWithFeatures(int features) {
+  simplefs_formatStripedDisk(features, 1, 1);
+}
+
+// Format filesystem as simplefs_formatDiskWithFeatures does, with the data
+// blocks striped over `members` image files, `stripe_blocks` consecutive
+// blocks on each in turn. The disk holds the metadata and the first stripe,
+// the other members are "simplefs.1" on. Each member is labelled with the
+// layout so mounting checks the set. Returns -1 if the layout is not
+// possible or a member can't be created
+int simplefs_formatStripedDisk(int features, int members, int stripe_blocks) {
+  if (members < 1 || members > MAX_STRIPE_MEMBERS || stripe_blocks < 1 ||
+      stripe_blocks > NUM_DATA_BLOCKS)
+    return -1;
+  simplefs_lockMetadata();
   FILE *fp;
   fp = fopen("simplefs", "w+");
   DISK_FD = fileno(fp);
@@ -38,8 +188,31 @@ void simplefs_formatDisk() {
   for (int i = 0; i < NUM_DATA_BLOCKS; i++) {
     superblock->datablock_freelist[i] = DATA_BLOCK_FREE;
   }
+  superblock->free_inodes = NUM_INODES;
+  superblock->free_blocks = NUM_DATA_BLOCKS;
+  superblock->stripe_members = members;
+  superblock->stripe_unit = stripe_blocks;
+  superblock->stripe_index = 0;
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  superblock->stripe_set = (short)(now.tv_sec ^ now.tv_nsec ^ getpid());
+  superblock->features = features;
+  DISK_FEATURES = features;
+  for (int i = 0; i < NUM_SNAPSHOTS; i++)
+    superblock->snapshots[i] = SNAPSHOT_FREE;
+  for (int i = 0; i < NUM_INODES; i++)
+    superblock->inode_map[i] = -1;
+  DISK_SHARING = simplefs_isShared();
+  LOG_HEAD = 0;
+  LOG_CLEANING = -1;
   simplefs_writeSuperBlock(superblock);
+  int ret = simplefs_openStripes(superblock, 1);
   free(superblock);
+  tail.inode_number = -1;
+  simplefs_invalidateInodeTable();
+  simplefs_invalidateDentries();
+  for (int i = 0; i < NUM_INODES; i++)
+    inode_table->generations[i]++;
 
   // Setting up inode structure
   struct inode_t *inode = (struct inode_t *)malloc(sizeof(struct inode_t));
@@ -48,37 +221,134 @@ void simplefs_formatDisk() {
   inode->file_size = 0;
   for (int i = 0; i < MAX_FILE_SIZE; i++)
     inode->direct_blocks[i] = -1;
+  inode->flags = 0;
+  memset(inode->inline_data, 0, INLINE_DATA_SIZE);
   for (int i = 0; i < NUM_INODES; i++)
     simplefs_writeInode(i, inode);
+  for (int s = 0; s < NUM_SNAPSHOTS; s++)
+    for (int i = 0; i < NUM_INODES; i++)
+      simplefs_writeSnapshotInode(s, i, inode);
   free(inode);
+  if (features & FEATURE_LOG)
+    simplefs_writeLogHead(0);
+  simplefs_formatChecksums();
+
+  // Setting up chunk maps, all chunks absent
+  struct chunk_t chunks[MAX_FILE_SIZE];
+  memset(chunks, 0, sizeof(chunks));
+  for (int i = 0; i < NUM_INODES; i++)
+    simplefs_writeChunkMap(i, chunks);
+  simplefs_invalidateChunks(-1);
+
+  // Dropping allocation windows of the old disk
+  for (int i = 0; i < NUM_INODES; i++)
+    simplefs_releaseWindow(i);
 
   // Formatting file handler array
   for (int i = 0; i < MAX_OPEN_FILES; i++) {
     file_handle_array[i].inode_number = -1;
     file_handle_array[i].offset = 0;
+    file_handle_array[i].snapshot = -1;
+    file_handle_array[i].flags = 0;
+  }
+  simplefs_unlockMetadata();
+  return ret;
+}
+
+// Open the disk formatted earlier and load its settings without changing it.
+// Returns -1 if there is no formatted disk
+int simplefs_openDisk() {
+  simplefs_flushTail(-1);
+  FILE *fp;
+  fp = fopen("simplefs", "r+");
+  if (fp == NULL)
+    return -1;
+  simplefs_lockMetadata();
+  DISK_FD = fileno(fp);
+  simplefs_invalidateInodeTable();
+  for (int i = 0; i < NUM_INODES; i++)
+    inode_table->generations[i]++;
+
+  // Checking the superblock
+  struct superblock_t *superblock =
+      (struct superblock_t *)malloc(sizeof(struct superblock_t));
+  simplefs_readSuperBlock(superblock);
+  if (memcmp(superblock->name, "simplefs", 8) ||
+      simplefs_openStripes(superblock, 0) == -1) {
+    free(superblock);
+    fclose(fp);
+    simplefs_unlockMetadata();
+    return -1;
+  }
+  DISK_FEATURES = superblock->features;
+  DISK_SHARING = simplefs_isShared();
+  LOG_HEAD = DISK_FEATURES & FEATURE_LOG ? simplefs_readLogHead(superblock) : 0;
+  LOG_CLEANING = -1;
+  for (int i = 0; i < NUM_DATA_BLOCKS; i++)
+    if (superblock->datablock_freelist[i] != DATA_BLOCK_FREE &&
+        superblock->datablock_freelist[i] != DATA_BLOCK_USED)
+      DISK_SHARING = 1;
+  free(superblock);
+
+  // Nothing cached or reserved from before
+  simplefs_invalidateChunks(-1);
+  simplefs_invalidateChecksums();
+  simplefs_invalidateDentries();
+  for (int i = 0; i < NUM_INODES; i++)
+    simplefs_releaseWindow(i);
+  for (int i = 0; i < MAX_OPEN_FILES; i++) {
+    file_handle_array[i].inode_number = -1;
+    file_handle_array[i].offset = 0;
+    file_handle_array[i].snapshot = -1;
+    file_handle_array[i].flags = 0;
   }
+  simplefs_unlockMetadata();
+  return 0;
+}
+
+// Open the disk formatted earlier and load its settings. Files deleted but
+// not yet reclaimed when it was last used are reclaimed now. Returns -1 if
+// there is no formatted disk
+int simplefs_mountDisk() {
+  if (simplefs_openDisk() == -1)
+    return -1;
+  simplefs_reclaim();
+  return 0;
 }
 
 // Iterate over `inode_freelist` and return index of first empty inode
 int simplefs_allocInode() {
+  simplefs_lockMetadata();
   struct superblock_t *superblock =
       (struct superblock_t *)malloc(sizeof(struct superblock_t));
   simplefs_readSuperBlock(superblock);
-  for (int i = 0; i < NUM_INODES; i++) {
+
+  // On log-structured disks the inode needs a data block of its own
+  int room = superblock->free_inodes > 0 &&
+             (!(DISK_FEATURES & FEATURE_LOG) || superblock->free_blocks > 0);
+  for (int i = 0; i < NUM_INODES && room; i++) {
     if (superblock->inode_freelist[i] == INODE_FREE) {
       superblock->inode_freelist[i] = INODE_IN_USE;
+      superblock->free_inodes--;
+      inode_table->generations[i]++;
       simplefs_writeSuperBlock(superblock);
       free(superblock);
+      simplefs_unlockMetadata();
       return i;
     }
   }
   free(superblock);
-  return -1;
+
+  // Out of room, reclaim deleted files and try again
+  int inodenum = simplefs_reclaim() > 0 ? simplefs_allocInode() : -1;
+  simplefs_unlockMetadata();
+  return inodenum;
 }
 
 // free inode with index `inodenum`
 void simplefs_freeInode(int inodenum) {
   assert(inodenum < NUM_INODES);
+  simplefs_lockMetadata();
   struct superblock_t *superblock =
       (struct superblock_t *)malloc(sizeof(struct superblock_t));
   struct inode_t *inode = (struct inode_t *)malloc(sizeof(struct inode_t));
@@ -86,82 +356,1009 @@ void simplefs_freeInode(int inodenum) {
   simplefs_readInode(inodenum, inode);
   assert(superblock->inode_freelist[inodenum] == INODE_IN_USE);
   superblock->inode_freelist[inodenum] = INODE_FREE;
+  superblock->free_inodes++;
   inode->status = INODE_FREE;
   inode->file_size = 0;
   for (int i = 0; i < MAX_FILE_SIZE; i++)
     inode->direct_blocks[i] = -1;
+  inode->flags = 0;
+  memset(inode->inline_data, 0, INLINE_DATA_SIZE);
   simplefs_writeSuperBlock(superblock);
   simplefs_writeInode(inodenum, inode);
   free(inode);
   free(superblock);
+  simplefs_unlockMetadata();
 }
 
-// read inode with index `inodenum` from disk into `inodeptr`
-void simplefs_readInode(int inodenum, struct inode_t *inodeptr) {
-  assert(inodenum < NUM_INODES);
+// Drop one user of data block `blocknum` in `superblock`, freeing the block
+// with the last one
+static void simplefs_unrefDataBlock(struct superblock_t *superblock,
+                                    int blocknum) {
+  assert(superblock->datablock_freelist[blocknum] != DATA_BLOCK_FREE);
+  if (superblock->datablock_freelist[blocknum] == DATA_BLOCK_USED) {
+    superblock->datablock_freelist[blocknum] = DATA_BLOCK_FREE;
+    superblock->free_blocks++;
+  } else {
+    superblock->datablock_freelist[blocknum]--;
+  }
+}
+
+// Mark free data block `blocknum` in `superblock` as used
+static void simplefs_takeDataBlock(struct superblock_t *superblock,
+                                   int blocknum) {
+  assert(superblock->datablock_freelist[blocknum] == DATA_BLOCK_FREE);
+  superblock->datablock_freelist[blocknum] = DATA_BLOCK_USED;
+  superblock->free_blocks--;
+}
+
+// Take the block at the head of the log for a log-structured disk described
+// by `superblock`. The log fills one clean segment after another, once none
+// is left it goes on through the free blocks after the head. Returns -1 if
+// the disk is full
+static int simplefs_logBlock(struct superblock_t *superblock) {
+  int blocknum = -1;
+  if (superblock->free_blocks == 0)
+    return -1;
+
+  // Carry on in the current segment
+  if (LOG_HEAD % SEGMENT_BLOCKS != 0 &&
+      superblock->datablock_freelist[LOG_HEAD] == DATA_BLOCK_FREE)
+    blocknum = LOG_HEAD;
+
+  // Otherwise start on the next clean segment
+  for (int n = 0; n < NUM_SEGMENTS && blocknum == -1; n++) {
+    int segment = (LOG_HEAD / SEGMENT_BLOCKS + n) % NUM_SEGMENTS;
+    int clean = segment != LOG_CLEANING;
+    for (int i = 0; i < SEGMENT_BLOCKS && clean; i++)
+      clean = superblock->datablock_freelist[segment * SEGMENT_BLOCKS + i] ==
+              DATA_BLOCK_FREE;
+    if (clean)
+      blocknum = segment * SEGMENT_BLOCKS;
+  }
+
+  // As a last resort take the next free block
+  for (int n = 0; n < NUM_DATA_BLOCKS && blocknum == -1; n++) {
+    int i = (LOG_HEAD + n) % NUM_DATA_BLOCKS;
+    if (superblock->datablock_freelist[i] == DATA_BLOCK_FREE &&
+        i / SEGMENT_BLOCKS != LOG_CLEANING)
+      blocknum = i;
+  }
+
+  // The head is written back when it leaves its segment or jumps, so a
+  // mount picks up the log where it left off
+  if (blocknum != -1) {
+    simplefs_takeDataBlock(superblock, blocknum);
+    if (blocknum != LOG_HEAD || blocknum % SEGMENT_BLOCKS == 0)
+      simplefs_writeLogHead(blocknum);
+    LOG_HEAD = (blocknum + 1) % NUM_DATA_BLOCKS;
+  }
+  return blocknum;
+}
+
+// read inode with index `inodenum` of a log-structured disk from the block
+// the inode map points at. Inodes never written read as free, and so do
+// those whose block fails its checksum, so no damaged block number is
+// followed. Returns -1 in that case
+static int simplefs_readLogInode(int inodenum, struct inode_t *inodeptr) {
+  struct superblock_t *superblock =
+      (struct superblock_t *)malloc(sizeof(struct superblock_t));
+  simplefs_readSuperBlock(superblock);
+  int blocknum = superblock->inode_map[inodenum];
+  free(superblock);
+
+  int ret = 0;
+  if (blocknum != -1) {
+    char tempBuf[BLOCKSIZE];
+    ret = simplefs_readDataBlock(blocknum, tempBuf);
+    if (ret == 0) {
+      memcpy(inodeptr, tempBuf, sizeof(struct inode_t));
+      return 0;
+    }
+  }
+  memset(inodeptr, 0, sizeof(struct inode_t));
+  inodeptr->status = INODE_FREE;
+  for (int i = 0; i < MAX_FILE_SIZE; i++)
+    inodeptr->direct_blocks[i] = -1;
+  return ret;
+}
+
+// write `inodeptr` to inode with index `inodenum` of a log-structured disk at
+// the head of the log and point the inode map at it. The old copy is freed,
+// free inodes keep no copy. If the disk is full the old copy is overwritten
+static void simplefs_writeLogInode(int inodenum, struct inode_t *inodeptr) {
+  simplefs_lockMetadata();
+  struct superblock_t *superblock =
+      (struct superblock_t *)malloc(sizeof(struct superblock_t));
+  simplefs_readSuperBlock(superblock);
+  int old = superblock->inode_map[inodenum];
+  int blocknum = -1;
+  if (inodeptr->status != INODE_FREE) {
+    blocknum = simplefs_logBlock(superblock);
+    if (blocknum == -1)
+      blocknum = old;
+    assert(blocknum != -1);
+    char tempBuf[BLOCKSIZE];
+    memcpy(tempBuf, inodeptr, sizeof(struct inode_t));
+    simplefs_writeDataBlock(blocknum, tempBuf);
+  }
+  if (old != -1 && old != blocknum)
+    simplefs_unrefDataBlock(superblock, old);
+  superblock->inode_map[inodenum] = blocknum;
+  simplefs_writeSuperBlock(superblock);
+  free(superblock);
+  simplefs_unlockMetadata();
+}
+
+// Byte offset on disk of the current copy of inode `inodenum`, -1 if a
+// log-structured disk holds none
+int simplefs_inodeOffset(int inodenum) {
+  if (!(DISK_FEATURES & FEATURE_LOG))
+    return BLOCKSIZE + inodenum * sizeof(struct inode_t);
+  struct superblock_t *superblock =
+      (struct superblock_t *)malloc(sizeof(struct superblock_t));
+  simplefs_readSuperBlock(superblock);
+  int blocknum = superblock->inode_map[inodenum];
+  free(superblock);
+  return blocknum == -1 ? -1 : (DATA_BLOCK_START + blocknum) * BLOCKSIZE;
+}
+
+// `name` up to its NUL as a zero padded 64-bit word
+static uint64_t simplefs_nameWord(const char *name) {
+  uint64_t word = 0;
+  memcpy(&word, name, strnlen(name, MAX_NAME_STRLEN));
+  return word;
+}
+
+// Update the in-core inode table with `inodeptr` written to inode `inodenum`
+static void simplefs_cacheInode(int inodenum, struct inode_t *inodeptr) {
+  simplefs_lockMetadata();
+  inode_table->status[inodenum] = inodeptr->status;
+  inode_table->names[inodenum] = inodeptr->status == INODE_IN_USE
+                                     ? simplefs_nameWord(inodeptr->name)
+                                     : 0;
+  inode_table->sizes[inodenum] = inodeptr->file_size;
+  inode_table->flags[inodenum] = inodeptr->flags;
+  simplefs_unlockMetadata();
+}
+
+// Read every inode into the in-core inode table
+static void simplefs_loadInodeTable() {
+  struct inode_t *inode = (struct inode_t *)malloc(sizeof(struct inode_t));
+  for (int i = 0; i < NUM_INODES; i++) {
+    simplefs_readInode(i, inode);
+    simplefs_cacheInode(i, inode);
+  }
+  inode_table->loaded = 1;
+  free(inode);
+}
+
+// Drop the in-core inode table after inodes were changed behind
+// simplefs_writeInode, it is read again on the next lookup. While attached
+// the shared copies of the metadata and data blocks go with it
+void simplefs_invalidateInodeTable() {
+  inode_table->loaded = 0;
+  simplefs_dropShared();
+}
+
+// Use inode table `table` in shared memory from now on, or the process's
+// own again if it is NULL. Other processes may then clone files, so writes
+// check for shared blocks
+void simplefs_shareMetadata(struct inode_table_t *table) {
+  simplefs_flushTail(-1);
+  inode_table = table != NULL ? table : &local_inode_table;
+  local_inode_table.loaded = 0;
+  if (table != NULL)
+    DISK_SHARING = 1;
+  simplefs_invalidateChunks(-1);
+  simplefs_invalidateDentries();
+}
+
+// 1 if inode `inodenum` is in use at the root rather than in a directory
+static int simplefs_atRoot(int inodenum) {
+  return inode_table->status[inodenum] == INODE_IN_USE &&
+         !(inode_table->flags[inodenum] & INODE_FLAG_CHILD);
+}
+
+// Find the in-use inode named `filename` at the root in the in-core inode
+// table. Returns its index, -1 if there is none
+int simplefs_findInode(char *filename) {
+  if (filename[0] == '\0' || strlen(filename) > MAX_NAME_STRLEN)
+    return -1;
+  simplefs_lockMetadata();
+  if (!inode_table->loaded)
+    simplefs_loadInodeTable();
+  uint64_t key = simplefs_nameWord(filename);
+  int i = 0, found = -1;
+
+#ifdef __SSE2__
+  // Two names per compare, a name matches if all eight of its bytes do
+  __m128i keys = _mm_set1_epi64x((long long)key);
+  for (; i + 2 <= NUM_INODES; i += 2) {
+    __m128i names = _mm_loadu_si128((__m128i *)&inode_table->names[i]);
+    int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(names, keys));
+    if ((mask & 0xff) == 0xff && simplefs_atRoot(i))
+      found = i;
+    else if ((mask >> 8) == 0xff && simplefs_atRoot(i + 1))
+      found = i + 1;
+    if (found != -1)
+      break;
+  }
+#endif
+
+  for (; i < NUM_INODES && found == -1; i++)
+    if (inode_table->names[i] == key && simplefs_atRoot(i))
+      found = i;
+  simplefs_unlockMetadata();
+  return found;
+}
+
+// INODE_FLAG_* flags of inode `inodenum`, from the in-core inode table
+int simplefs_inodeFlags(int inodenum) {
+  simplefs_lockMetadata();
+  if (!inode_table->loaded)
+    simplefs_loadInodeTable();
+  int flags = inode_table->flags[inodenum];
+  simplefs_unlockMetadata();
+  return flags;
+}
+
+// Generation of inode `inodenum`, changing whenever it is reused for another
+// file
+int simplefs_inodeGeneration(int inodenum) {
+  simplefs_lockMetadata();
+  int generation = inode_table->generations[inodenum];
+  simplefs_unlockMetadata();
+  return generation;
+}
+
+// read inode `inodenum` into `inodeptr` as simplefs_readInode does, without
+// looking at the cached append
+static int simplefs_loadInode(int inodenum, struct inode_t *inodeptr) {
+  if (batch.active) {
+    memcpy(inodeptr,
+           batch.metadata + BLOCKSIZE + inodenum * sizeof(struct inode_t),
+           sizeof(struct inode_t));
+    return 0;
+  }
+  if (DISK_FEATURES & FEATURE_LOG)
+    return simplefs_readLogInode(inodenum, inodeptr);
   char tempBuf[BLOCKSIZE / NUM_INODES_PER_BLOCK];
-  lseek(DISK_FD, BLOCKSIZE + inodenum * sizeof(struct inode_t), SEEK_SET);
-  int ret = read(DISK_FD, tempBuf, sizeof(struct inode_t));
-  assert(ret == sizeof(struct inode_t));
+  simplefs_readMetadata(BLOCKSIZE + inodenum * sizeof(struct inode_t), tempBuf,
+                        sizeof(struct inode_t));
   memcpy(inodeptr, tempBuf, sizeof(struct inode_t));
+  return 0;
+}
+
+// Free the inodes and data blocks of deleted files left as orphans, with one
+// free map update for all of them. The inodes are cleared first, so a crash
+// in between leaks their blocks until fsck rather than freeing them twice.
+// Block numbers off the disk or already free are skipped and left to fsck.
+// Returns the number of files reclaimed
+int simplefs_reclaim() {
+  simplefs_lockMetadata();
+  if (!inode_table->loaded)
+    simplefs_loadInodeTable();
+  struct inode_t *inode = (struct inode_t *)malloc(sizeof(struct inode_t));
+  int orphans[NUM_INODES], count = 0;
+  int blocknums[NUM_INODES * MAX_FILE_SIZE], nblocks = 0;
+  for (int i = 0; i < NUM_INODES; i++) {
+    if (inode_table->status[i] != INODE_ORPHAN)
+      continue;
+    simplefs_loadInode(i, inode);
+    for (int j = 0; j < MAX_FILE_SIZE; j++)
+      if (inode->direct_blocks[j] != -1)
+        blocknums[nblocks++] = inode->direct_blocks[j];
+
+    // Forget the chunks of a compressed file
+    if (DISK_FEATURES & FEATURE_COMPRESSION) {
+      struct chunk_t chunks[MAX_FILE_SIZE];
+      memset(chunks, 0, sizeof(chunks));
+      simplefs_writeChunkMap(i, chunks);
+    }
+
+    memset(inode, 0, sizeof(struct inode_t));
+    inode->status = INODE_FREE;
+    for (int j = 0; j < MAX_FILE_SIZE; j++)
+      inode->direct_blocks[j] = -1;
+    simplefs_writeInode(i, inode);
+    orphans[count++] = i;
+  }
+  free(inode);
+
+  if (count > 0) {
+    struct superblock_t *superblock =
+        (struct superblock_t *)malloc(sizeof(struct superblock_t));
+    simplefs_readSuperBlock(superblock);
+    for (int i = 0; i < nblocks; i++)
+      if (blocknums[i] >= 0 && blocknums[i] < NUM_DATA_BLOCKS &&
+          superblock->datablock_freelist[blocknums[i]] != DATA_BLOCK_FREE)
+        simplefs_unrefDataBlock(superblock, blocknums[i]);
+    for (int i = 0; i < count; i++)
+      superblock->inode_freelist[orphans[i]] = INODE_FREE;
+    superblock->free_inodes += count;
+    simplefs_writeSuperBlock(superblock);
+    free(superblock);
+  }
+  simplefs_unlockMetadata();
+  return count;
+}
+
+// read inode with index `inodenum` from disk into `inodeptr`. The cached
+// append is checked under the metadata lock, so it is never written back
+// halfway through an append. Returns -1 if the inode fails its checksum, it
+// then reads as free
+int simplefs_readInode(int inodenum, struct inode_t *inodeptr) {
+  assert(inodenum < NUM_INODES);
+  simplefs_lockMetadata();
+  if (tail.inode_number == inodenum)
+    simplefs_flushTail(inodenum);
+  simplefs_unlockMetadata();
+  return simplefs_loadInode(inodenum, inodeptr);
 }
 
 // write `inodeptr` to inode with index `inodenum` on disk
 void simplefs_writeInode(int inodenum, struct inode_t *inodeptr) {
   assert(inodenum < NUM_INODES);
+  simplefs_cacheInode(inodenum, inodeptr);
+  if (batch.active) {
+    memcpy(batch.metadata + BLOCKSIZE + inodenum * sizeof(struct inode_t),
+           inodeptr, sizeof(struct inode_t));
+    batch.dirty[inodenum / NUM_INODES_PER_BLOCK] = 1;
+    return;
+  }
+  if (DISK_FEATURES & FEATURE_LOG) {
+    simplefs_writeLogInode(inodenum, inodeptr);
+    return;
+  }
   char tempBuf[BLOCKSIZE / NUM_INODES_PER_BLOCK];
   memcpy(tempBuf, inodeptr, sizeof(struct inode_t));
-  lseek(DISK_FD, BLOCKSIZE + inodenum * sizeof(struct inode_t), SEEK_SET);
-  int ret = write(DISK_FD, tempBuf, sizeof(struct inode_t));
-  assert(ret == sizeof(struct inode_t));
+  simplefs_writeMetadata(BLOCKSIZE + inodenum * sizeof(struct inode_t),
+                         tempBuf, sizeof(struct inode_t));
+}
+
+// Hold the superblock and inode table in memory until simplefs_endBatch, so
+// a run of operations reads them once and writes each changed block once.
+// Data blocks are still written through, their checksums are held back too
+void simplefs_beginBatch() {
+  simplefs_lockMetadata();
+  assert(!batch.active);
+  simplefs_flushTail(-1);
+  simplefs_readMetadata(0, batch.metadata, sizeof(batch.metadata));
+  if (DISK_FEATURES & FEATURE_LOG)
+    for (int i = 0; i < NUM_INODES; i++)
+      simplefs_readLogInode(
+          i, (struct inode_t *)(batch.metadata + BLOCKSIZE +
+                                i * sizeof(struct inode_t)));
+  batch.superblock_dirty = 0;
+  memset(batch.dirty, 0, sizeof(batch.dirty));
+  batch.active = 1;
+}
+
+// Write back the metadata changed since simplefs_beginBatch, one write per
+// run of changed blocks
+void simplefs_endBatch() {
+  assert(batch.active);
+  batch.active = 0;
+  simplefs_flushChecksums();
+  if (batch.superblock_dirty)
+    simplefs_writeMetadata(0, batch.metadata, BLOCKSIZE);
+
+  // Log-structured disks append each changed inode once
+  if (DISK_FEATURES & FEATURE_LOG) {
+    for (int i = 0; i < NUM_INODES; i++)
+      if (batch.dirty[i / NUM_INODES_PER_BLOCK])
+        simplefs_writeLogInode(
+            i, (struct inode_t *)(batch.metadata + BLOCKSIZE +
+                                  i * sizeof(struct inode_t)));
+    simplefs_unlockMetadata();
+    return;
+  }
+  for (int i = 0, run; i < NUM_INODE_BLOCKS; i += run) {
+    run = 1;
+    if (!batch.dirty[i])
+      continue;
+    while (i + run < NUM_INODE_BLOCKS && batch.dirty[i + run])
+      run++;
+    simplefs_writeMetadata((1 + i) * BLOCKSIZE,
+                           batch.metadata + (1 + i) * BLOCKSIZE,
+                           run * BLOCKSIZE);
+  }
+  simplefs_unlockMetadata();
+}
+
+// Append `nbytes` of `buf` to inode `inodenum` in the cached last block,
+// writing the block and inode only once the block is full. Returns -1 if the
+// data doesn't fit the last block or the file isn't a plain one with its own
+// last block, for the caller to write it out. Nothing is cached while
+// attached, other processes would not see the appends
+int simplefs_appendTail(int inodenum, char *buf, int nbytes) {
+  if (simplefs_isShared())
+    return -1;
+
+  // Start caching the last block of this file
+  if (tail.inode_number != inodenum) {
+    simplefs_flushTail(-1);
+    simplefs_readInode(inodenum, &tail.inode);
+    int size = tail.inode.file_size;
+    if (tail.inode.flags & INODE_FLAG_INLINE ||
+        DISK_FEATURES & (FEATURE_COMPRESSION | FEATURE_LOG) ||
+        size % BLOCKSIZE == 0)
+      return -1;
+    int blocknum = tail.inode.direct_blocks[size / BLOCKSIZE];
+    if (blocknum == -1 ||
+        (DISK_SHARING && simplefs_dataBlockRefs(blocknum) > 1) ||
+        simplefs_readDataBlock(blocknum, tail.block) == -1)
+      return -1;
+    tail.inode_number = inodenum;
+    tail.dirty = 0;
+  }
+
+  int ls = tail.inode.file_size % BLOCKSIZE;
+  if (ls + nbytes > BLOCKSIZE)
+    return -1;
+  memcpy(tail.block + ls, buf, nbytes);
+  tail.inode.file_size += nbytes;
+  inode_table->sizes[inodenum] = tail.inode.file_size;
+  tail.dirty = 1;
+  if (ls + nbytes == BLOCKSIZE)
+    simplefs_flushTail(inodenum);
+  return 0;
+}
+
+// Write back the cached last block of inode `inodenum`, or of any inode if
+// it is -1, and stop caching it. Appends fill the block under the metadata
+// lock, so it is taken here too
+void simplefs_flushTail(int inodenum) {
+  simplefs_lockMetadata();
+  if (tail.inode_number == -1 ||
+      (inodenum != -1 && tail.inode_number != inodenum)) {
+    simplefs_unlockMetadata();
+    return;
+  }
+  int cached = tail.inode_number;
+  tail.inode_number = -1;
+  if (tail.dirty) {
+    int last = (tail.inode.file_size - 1) / BLOCKSIZE;
+    simplefs_writeDataBlock(tail.inode.direct_blocks[last], tail.block);
+    simplefs_writeInode(cached, &tail.inode);
+  }
+  simplefs_unlockMetadata();
 }
 
 // Iterate over `datablock_freelist` and return index of first empty inode
-int simplefs_allocDataBlock() {
+int simplefs_allocDataBlock() { return simplefs_allocDataBlockNear(-1, 0); }
+
+// Whether data block `blocknum` lies in the window of an inode other than
+// `inodenum`
+static int simplefs_inOtherWindow(int inodenum, int blocknum) {
+  for (int i = 0; i < NUM_INODES; i++)
+    if (i != inodenum && alloc_window[i].start <= blocknum &&
+        blocknum < alloc_window[i].end)
+      return 1;
+  return 0;
+}
+
+// Take a free block in `superblock` for inode `inodenum` near block `goal`,
+// as simplefs_allocDataBlockNear does. Returns -1 if there is none
+static int simplefs_nearBlock(struct superblock_t *superblock, int inodenum,
+                              int goal) {
+  if (superblock->free_blocks == 0)
+    return -1;
+  if (goal < 0 || goal >= NUM_DATA_BLOCKS)
+    goal = 0;
+
+  int blocknum = -1;
+  struct window_t *window = inodenum == -1 ? NULL : &alloc_window[inodenum];
+
+  // Take the next free block of the inode's own window
+  if (RESERVATION_WINDOW && window != NULL) {
+    int from = goal > window->start ? goal : window->start;
+    for (int i = from; i < window->end && blocknum == -1; i++)
+      if (superblock->datablock_freelist[i] == DATA_BLOCK_FREE)
+        blocknum = i;
+  }
+
+  // Otherwise search forward from the goal, wrapping around, skipping
+  // blocks reserved for other inodes
+  for (int n = 0; n < NUM_DATA_BLOCKS && blocknum == -1; n++) {
+    int i = (goal + n) % NUM_DATA_BLOCKS;
+    if (superblock->datablock_freelist[i] == DATA_BLOCK_FREE &&
+        !simplefs_inOtherWindow(inodenum, i))
+      blocknum = i;
+  }
+
+  // Open a new window after a block found outside the old one
+  if (RESERVATION_WINDOW && window != NULL && blocknum != -1 &&
+      (blocknum < window->start || blocknum >= window->end)) {
+    window->start = blocknum;
+    window->end = blocknum + 1;
+    while (window->end < NUM_DATA_BLOCKS &&
+           window->end - window->start < RESERVATION_WINDOW &&
+           superblock->datablock_freelist[window->end] == DATA_BLOCK_FREE &&
+           !simplefs_inOtherWindow(inodenum, window->end))
+      window->end++;
+  }
+
+  // As a last resort take any free block, even a reserved one
+  for (int i = 0; i < NUM_DATA_BLOCKS && blocknum == -1; i++)
+    if (superblock->datablock_freelist[i] == DATA_BLOCK_FREE)
+      blocknum = i;
+  if (blocknum != -1)
+    simplefs_takeDataBlock(superblock, blocknum);
+  return blocknum;
+}
+
+// Allocate a data block for inode `inodenum` (-1 for none), searching forward
+// from block `goal` so a file's blocks stay together. With reservation
+// windows enabled the inode keeps a run of blocks that other inodes skip.
+// Returns -1 if the disk is full
+int simplefs_allocDataBlockNear(int inodenum, int goal) {
+  simplefs_lockMetadata();
   struct superblock_t *superblock =
       (struct superblock_t *)malloc(sizeof(struct superblock_t));
   simplefs_readSuperBlock(superblock);
-  for (int i = 0; i < NUM_DATA_BLOCKS; i++) {
-    if (superblock->datablock_freelist[i] == DATA_BLOCK_FREE) {
-      superblock->datablock_freelist[i] = DATA_BLOCK_USED;
-      simplefs_writeSuperBlock(superblock);
-      free(superblock);
-      return i;
+
+  // Log-structured disks always write at the head of the log
+  int blocknum = DISK_FEATURES & FEATURE_LOG
+                     ? simplefs_logBlock(superblock)
+                     : simplefs_nearBlock(superblock, inodenum, goal);
+  if (blocknum != -1)
+    simplefs_writeSuperBlock(superblock);
+  free(superblock);
+
+  // Out of space, reclaim deleted files and try again
+  if (blocknum == -1 && simplefs_reclaim() > 0)
+    blocknum = simplefs_allocDataBlockNear(inodenum, goal);
+  simplefs_unlockMetadata();
+  return blocknum;
+}
+
+// Reserve windows of `blocks` blocks for appending inodes, 0 to disable
+void simplefs_setReservationWindow(int blocks) {
+  RESERVATION_WINDOW = blocks;
+  for (int i = 0; i < NUM_INODES; i++)
+    simplefs_releaseWindow(i);
+}
+
+// Give back the allocation window of inode `inodenum`
+void simplefs_releaseWindow(int inodenum) {
+  alloc_window[inodenum].start = 0;
+  alloc_window[inodenum].end = 0;
+}
+
+// Fill `stats` with usage and fragmentation figures of the disk
+void simplefs_getStats(struct stats_t *stats) {
+  struct inode_t *inode = (struct inode_t *)malloc(sizeof(struct inode_t));
+  memset(stats, 0, sizeof(struct stats_t));
+  for (int i = 0; i < NUM_INODES; i++) {
+    simplefs_readInode(i, inode);
+    if (inode->status != INODE_IN_USE)
+      continue;
+    stats->files++;
+
+    // Count runs of consecutive blocks
+    for (int j = 0; j < MAX_FILE_SIZE; j++) {
+      if (inode->direct_blocks[j] == -1)
+        continue;
+      stats->used_blocks++;
+      if (j == 0 || inode->direct_blocks[j] != inode->direct_blocks[j - 1] + 1)
+        stats->extents++;
     }
   }
+  if (stats->files > 0)
+    stats->extents_per_file = (float)stats->extents / stats->files;
+  free(inode);
+}
+
+// Fill `statfs` with the capacity and free space of the disk, from the
+// counters in the superblock
+void simplefs_statfs(struct statfs_t *statfs) {
+  struct superblock_t *superblock =
+      (struct superblock_t *)malloc(sizeof(struct superblock_t));
+  simplefs_readSuperBlock(superblock);
+  statfs->block_size = BLOCKSIZE;
+  statfs->total_blocks = NUM_DATA_BLOCKS;
+  statfs->free_blocks = superblock->free_blocks;
+  statfs->total_inodes = NUM_INODES;
+  statfs->free_inodes = superblock->free_inodes;
   free(superblock);
-  return -1;
 }
 
-// free data block with index `blocknum`
+// Fill up to `max` of `entries` with the files in use from inode `*cursor`
+// on, from the in-core inode table without reading any data block, and move
+// `*cursor` past the last one. Start with `*cursor` at 0 and call again
+// until it returns 0. Entries of directories carry the start of their name
+// as their inode keeps it. Returns the number of entries filled
+int simplefs_list(int *cursor, struct list_entry_t *entries, int max) {
+  simplefs_lockMetadata();
+  if (!inode_table->loaded)
+    simplefs_loadInodeTable();
+  int count = 0;
+  int i = *cursor < 0 ? 0 : *cursor;
+  for (; i < NUM_INODES && count < max; i++) {
+    if (inode_table->status[i] != INODE_IN_USE)
+      continue;
+    entries[count].inode_number = i;
+    memcpy(entries[count].name, &inode_table->names[i], MAX_NAME_STRLEN);
+    entries[count].name[MAX_NAME_STRLEN] = '\0';
+    entries[count].size = inode_table->sizes[i];
+    entries[count].flags = inode_table->flags[i];
+    count++;
+  }
+  *cursor = i;
+  simplefs_unlockMetadata();
+  return count;
+}
+
+// free data block with index `blocknum`, once no one else shares it
 void simplefs_freeDataBlock(int blocknum) {
+  simplefs_lockMetadata();
   struct superblock_t *superblock =
       (struct superblock_t *)malloc(sizeof(struct superblock_t));
   simplefs_readSuperBlock(superblock);
-  assert(superblock->datablock_freelist[blocknum] == DATA_BLOCK_USED);
-  superblock->datablock_freelist[blocknum] = DATA_BLOCK_FREE;
+  simplefs_unrefDataBlock(superblock, blocknum);
   simplefs_writeSuperBlock(superblock);
   free(superblock);
+  simplefs_unlockMetadata();
+}
+
+// Make sure `count` data blocks can be allocated before allocating any,
+// reclaiming deleted files if it takes that. On success the metadata lock is
+// held until simplefs_unreserveDataBlocks, so no one else takes the blocks.
+// Returns -1 with errno set to ENOSPC if there are not enough free blocks
+int simplefs_reserveDataBlocks(int count) {
+  simplefs_lockMetadata();
+  struct superblock_t *superblock =
+      (struct superblock_t *)malloc(sizeof(struct superblock_t));
+  simplefs_readSuperBlock(superblock);
+  if (superblock->free_blocks < count && simplefs_reclaim() > 0)
+    simplefs_readSuperBlock(superblock);
+  int ret = superblock->free_blocks < count ? -1 : 0;
+  free(superblock);
+  if (ret == -1) {
+    simplefs_unlockMetadata();
+    errno = ENOSPC;
+  }
+  return ret;
 }
 
-// read data block with index `blocknum` from disk into `buf`
-void simplefs_readDataBlock(int blocknum, char *buf) {
+// Let others allocate again after simplefs_reserveDataBlocks
+void simplefs_unreserveDataBlocks() { simplefs_unlockMetadata(); }
+
+// Take `count` free blocks in `superblock` for simplefs_allocDataBlocks.
+// Returns -1 if there are not enough
+static int simplefs_pickDataBlocks(struct superblock_t *superblock, int count,
+                                   int *blocknums) {
+  if (superblock->free_blocks < count)
+    return -1;
+  // Log-structured disks take them one after another from the log
+  if (DISK_FEATURES & FEATURE_LOG) {
+    for (int i = 0; i < count; i++) {
+      blocknums[i] = simplefs_logBlock(superblock);
+      if (blocknums[i] == -1)
+        return -1;
+    }
+    return 0;
+  }
+
+  // Look for the first free run long enough
+  int start = 0;
+  for (int i = 0, run = 0; i < NUM_DATA_BLOCKS; i++) {
+    run = superblock->datablock_freelist[i] == DATA_BLOCK_FREE ? run + 1 : 0;
+    if (run == count) {
+      start = i - count + 1;
+      break;
+    }
+  }
+
+  // Take free blocks from there, scattered if no run was found
+  int n = 0;
+  for (int i = start; i < NUM_DATA_BLOCKS && n < count; i++)
+    if (superblock->datablock_freelist[i] == DATA_BLOCK_FREE)
+      blocknums[n++] = i;
+  if (n < count)
+    return -1;
+  for (int i = 0; i < count; i++)
+    simplefs_takeDataBlock(superblock, blocknums[i]);
+  return 0;
+}
+
+// Allocate `count` data blocks with a single superblock update, preferring
+// one contiguous run. Stores their indices in `blocknums`, returns -1 if there
+// are not enough free blocks
+int simplefs_allocDataBlocks(int count, int *blocknums) {
+  simplefs_lockMetadata();
+  struct superblock_t *superblock =
+      (struct superblock_t *)malloc(sizeof(struct superblock_t));
+  simplefs_readSuperBlock(superblock);
+  int ret = simplefs_pickDataBlocks(superblock, count, blocknums);
+  if (ret == 0)
+    simplefs_writeSuperBlock(superblock);
+  free(superblock);
+
+  // Out of space, reclaim deleted files and try again
+  if (ret == -1 && simplefs_reclaim() > 0)
+    ret = simplefs_allocDataBlocks(count, blocknums);
+  simplefs_unlockMetadata();
+  return ret;
+}
+
+// Allocate a run of `count` consecutive data blocks starting before block
+// `limit`, the lowest one found. Returns its first block, -1 if there is none
+int simplefs_allocDataRun(int count, int limit) {
+  // Log-structured disks don't place blocks by position
+  if (DISK_FEATURES & FEATURE_LOG)
+    return -1;
+  simplefs_lockMetadata();
+  struct superblock_t *superblock =
+      (struct superblock_t *)malloc(sizeof(struct superblock_t));
+  simplefs_readSuperBlock(superblock);
+  int start = -1;
+  for (int i = 0, run = 0; i < NUM_DATA_BLOCKS && i - run < limit; i++) {
+    run = superblock->datablock_freelist[i] == DATA_BLOCK_FREE ? run + 1 : 0;
+    if (run < count)
+      continue;
+    start = i - count + 1;
+    for (int j = start; j <= i; j++)
+      simplefs_takeDataBlock(superblock, j);
+    simplefs_writeSuperBlock(superblock);
+    break;
+  }
+  free(superblock);
+
+  // No run free, reclaim deleted files and try again
+  if (start == -1 && simplefs_reclaim() > 0)
+    start = simplefs_allocDataRun(count, limit);
+  simplefs_unlockMetadata();
+  return start;
+}
+
+// free the `count` data blocks in `blocknums` with a single superblock update
+void simplefs_freeDataBlocks(int *blocknums, int count) {
+  if (count == 0)
+    return;
+  simplefs_lockMetadata();
+  struct superblock_t *superblock =
+      (struct superblock_t *)malloc(sizeof(struct superblock_t));
+  simplefs_readSuperBlock(superblock);
+  for (int i = 0; i < count; i++)
+    simplefs_unrefDataBlock(superblock, blocknums[i]);
+  simplefs_writeSuperBlock(superblock);
+  free(superblock);
+  simplefs_unlockMetadata();
+}
+
+// Add a user to each of the `count` data blocks in `blocknums` with a single
+// superblock update. Returns -1, changing nothing, if one is at MAX_BLOCK_REFS
+int simplefs_shareDataBlocks(int *blocknums, int count) {
+  if (count == 0)
+    return 0;
+  simplefs_lockMetadata();
+  struct superblock_t *superblock =
+      (struct superblock_t *)malloc(sizeof(struct superblock_t));
+  simplefs_readSuperBlock(superblock);
+  int ret = 0;
+  for (int i = 0; i < count; i++) {
+    assert(superblock->datablock_freelist[blocknums[i]] != DATA_BLOCK_FREE);
+    superblock->datablock_freelist[blocknums[i]]++;
+  }
+  for (int i = 0; i < count; i++)
+    if (superblock->datablock_freelist[blocknums[i]] > '0' + MAX_BLOCK_REFS)
+      ret = -1;
+  if (ret == 0) {
+    simplefs_writeSuperBlock(superblock);
+    DISK_SHARING = 1;
+  }
+  free(superblock);
+  simplefs_unlockMetadata();
+  return ret;
+}
+
+// Give inode `inodenum` its own copy of data block `blocknum` before writing
+// to it, if the block is shared. Log-structured disks never write in place,
+// so there every block moves to the head of the log. The copy is allocated
+// near `goal` and, with `copy` set, filled with the old contents. Returns the
+// block to write to, -1 if the disk is full or the old contents fail their
+// checksum
+int simplefs_unshareDataBlock(int inodenum, int blocknum, int goal, int copy) {
+  if (!(DISK_FEATURES & FEATURE_LOG) &&
+      (!DISK_SHARING || simplefs_dataBlockRefs(blocknum) <= 1))
+    return blocknum;
+
+  int newblock = simplefs_allocDataBlockNear(inodenum, goal);
+  if (newblock == -1)
+    return -1;
+  if (copy) {
+    char tempBuf[BLOCKSIZE];
+    if (simplefs_readDataBlock(blocknum, tempBuf) == -1) {
+      simplefs_freeDataBlock(newblock);
+      return -1;
+    }
+    simplefs_writeDataBlock(newblock, tempBuf);
+  }
+  simplefs_freeDataBlock(blocknum);
+  return newblock;
+}
+
+// Number of users of data block `blocknum`, 0 if it is free
+int simplefs_dataBlockRefs(int blocknum) {
+  struct superblock_t *superblock =
+      (struct superblock_t *)malloc(sizeof(struct superblock_t));
+  simplefs_readSuperBlock(superblock);
+  int refs = superblock->datablock_freelist[blocknum] == DATA_BLOCK_FREE
+                 ? 0
+                 : superblock->datablock_freelist[blocknum] - '0';
+  free(superblock);
+  return refs;
+}
+
+// read `count` consecutive data blocks from `blocknum` into `buf`, or with
+// `write` set fill them with `buf`, straight from the disk
+static void simplefs_diskIO(int write, int blocknum, int count, char *buf) {
+  if (STRIPE_MEMBERS > 1) {
+    simplefs_stripeIO(write, blocknum, count, buf);
+    return;
+  }
+  off_t offset = BLOCKSIZE * (DATA_BLOCK_START + blocknum);
+  int ret = write ? pwrite(DISK_FD, buf, count * BLOCKSIZE, offset)
+                  : pread(DISK_FD, buf, count * BLOCKSIZE, offset);
+  assert(ret == count * BLOCKSIZE);
+}
+
+// read `count` consecutive data blocks from `blocknum` into `buf`, or with
+// `write` set fill them with `buf`, in one request. While attached the blocks
+// come from the shared cache when it holds them all, and writes go through
+// it to the disk. FEATURE_CHECKSUM disks check what they read from disk and
+// record the checksums of what they write, held back to the end of a batch
+// like the rest of the metadata. Returns -1, with errno set to EIO, if a
+// block read doesn't match its checksum
+static int simplefs_dataIO(int write, int blocknum, int count, char *buf) {
+  int shared = simplefs_lockShared() == 0;
+  char *cached =
+      shared && !write ? simplefs_sharedBlocks(blocknum, count) : NULL;
+  int checked = cached == NULL && (DISK_FEATURES & FEATURE_CHECKSUM);
+  int ret = 0;
+  if (checked)
+    simplefs_lockChecksums();
+  if (cached != NULL)
+    memcpy(buf, cached, count * BLOCKSIZE);
+  else
+    simplefs_diskIO(write, blocknum, count, buf);
+  if (checked && write)
+    simplefs_storeChecksums(blocknum, count, buf, batch.active);
+  else if (checked)
+    ret = simplefs_verifyChecksums(blocknum, count, buf);
+  if (checked)
+    simplefs_unlockChecksums();
+
+  // Blocks that failed the check are not cached for the other processes
+  if (shared) {
+    if (cached == NULL && ret == 0)
+      simplefs_cacheShared(blocknum, count, buf);
+    if (write)
+      simplefs_touchShared();
+    simplefs_unlockShared();
+  }
+  if (ret == -1)
+    errno = EIO;
+  return ret;
+}
+
+// read data block with index `blocknum` from disk into `buf`. Returns -1 if
+// it fails its checksum
+int simplefs_readDataBlock(int blocknum, char *buf) {
   assert(blocknum < NUM_DATA_BLOCKS);
-  char tempBuf[BLOCKSIZE];
-  lseek(DISK_FD, BLOCKSIZE * (5 + blocknum), SEEK_SET);
-  int ret = read(DISK_FD, tempBuf, BLOCKSIZE);
-  assert(ret == BLOCKSIZE);
-  memcpy(buf, tempBuf, BLOCKSIZE);
+  return simplefs_dataIO(0, blocknum, 1, buf);
+}
+
+// read `count` consecutive data blocks from `blocknum` into `buf` in one read.
+// Returns -1 if one fails its checksum
+int simplefs_readDataBlocks(int blocknum, int count, char *buf) {
+  assert(blocknum + count <= NUM_DATA_BLOCKS);
+  return simplefs_dataIO(0, blocknum, count, buf);
 }
 
 // fill `buf` with data from `blocknum`
 void simplefs_writeDataBlock(int blocknum, char *buf) {
   assert(blocknum < NUM_DATA_BLOCKS);
+  simplefs_dataIO(1, blocknum, 1, buf);
+}
+
+// fill `count` consecutive data blocks from `blocknum` with `buf` in one write
+void simplefs_writeDataBlocks(int blocknum, int count, char *buf) {
+  assert(blocknum + count <= NUM_DATA_BLOCKS);
+  simplefs_dataIO(1, blocknum, count, buf);
+}
+
+// Check data block `blocknum` on disk against its checksum, past the shared
+// cache. Returns -1 if they differ, 0 if they match or the disk keeps no
+// checksums
+int simplefs_verifyDataBlock(int blocknum) {
+  assert(blocknum < NUM_DATA_BLOCKS);
+  if (!(DISK_FEATURES & FEATURE_CHECKSUM))
+    return 0;
   char tempBuf[BLOCKSIZE];
-  lseek(DISK_FD, BLOCKSIZE * (5 + blocknum), SEEK_SET);
-  memcpy(tempBuf, buf, BLOCKSIZE);
-  int ret = write(DISK_FD, tempBuf, BLOCKSIZE);
-  assert(ret == BLOCKSIZE);
+  int shared = simplefs_lockShared() == 0;
+  simplefs_lockChecksums();
+  simplefs_diskIO(0, blocknum, 1, tempBuf);
+  int ret = simplefs_verifyChecksums(blocknum, 1, tempBuf);
+  simplefs_unlockChecksums();
+  if (shared)
+    simplefs_unlockShared();
+  return ret;
+}
+
+// read chunk map of inode with index `inodenum` from disk into `chunks`
+void simplefs_readChunkMap(int inodenum, struct chunk_t *chunks) {
+  assert(inodenum < NUM_INODES);
+  int ret = pread(DISK_FD, chunks, MAX_FILE_SIZE * sizeof(struct chunk_t),
+                  BLOCKSIZE * CHUNK_MAP_START +
+                      inodenum * MAX_FILE_SIZE * sizeof(struct chunk_t));
+  assert(ret == MAX_FILE_SIZE * sizeof(struct chunk_t));
+}
+
+// write `chunks` to chunk map of inode with index `inodenum` on disk
+void simplefs_writeChunkMap(int inodenum, struct chunk_t *chunks) {
+  assert(inodenum < NUM_INODES);
+  int shared = simplefs_lockShared() == 0;
+  int ret = pwrite(DISK_FD, chunks, MAX_FILE_SIZE * sizeof(struct chunk_t),
+                   BLOCKSIZE * CHUNK_MAP_START +
+                       inodenum * MAX_FILE_SIZE * sizeof(struct chunk_t));
+  assert(ret == MAX_FILE_SIZE * sizeof(struct chunk_t));
+
+  // Other attached processes drop the chunks they decompressed
+  if (shared) {
+    simplefs_touchShared();
+    simplefs_unlockShared();
+  }
+}
+
+// write `inodeptr` to inode with index `inodenum` of snapshot `snapshot`
+void simplefs_writeSnapshotInode(int snapshot, int inodenum,
+                                 struct inode_t *inodeptr) {
+  assert(snapshot < NUM_SNAPSHOTS && inodenum < NUM_INODES);
+  int ret = pwrite(DISK_FD, inodeptr, sizeof(struct inode_t),
+                   BLOCKSIZE * (SNAPSHOT_START + snapshot * NUM_INODE_BLOCKS) +
+                       inodenum * sizeof(struct inode_t));
+  assert(ret == sizeof(struct inode_t));
+}
+
+// read inode with index `inodenum` of snapshot `snapshot` into `inodeptr`
+void simplefs_readSnapshotInode(int snapshot, int inodenum,
+                                struct inode_t *inodeptr) {
+  assert(snapshot < NUM_SNAPSHOTS && inodenum < NUM_INODES);
+  int ret = pread(DISK_FD, inodeptr, sizeof(struct inode_t),
+                  BLOCKSIZE * (SNAPSHOT_START + snapshot * NUM_INODE_BLOCKS) +
+                      inodenum * sizeof(struct inode_t));
+  assert(ret == sizeof(struct inode_t));
+}
+
+// Print the entries in use of directory `inodenum`
+static void simplefs_dumpDir(int inodenum, struct inode_t *inode) {
+  struct chunk_t chunks[MAX_FILE_SIZE];
+  if (DISK_FEATURES & FEATURE_COMPRESSION)
+    simplefs_readChunkMap(inodenum, chunks);
+  for (int j = 0; j < MAX_FILE_SIZE; j++) {
+    struct dirent_t entries[DIRENTS_PER_BLOCK];
+    if (DISK_FEATURES & FEATURE_COMPRESSION) {
+      if (chunks[j].length == 0)
+        continue;
+      simplefs_readChunk(inodenum, j, (char *)entries);
+    } else {
+      if (inode->direct_blocks[j] == -1)
+        continue;
+      simplefs_readDataBlock(inode->direct_blocks[j], (char *)entries);
+    }
+    for (int k = 0; k < DIRENTS_PER_BLOCK; k++) {
+      if (entries[k].status != DIRENT_IN_USE)
+        continue;
+      char name[DIR_NAME_LEN + 1];
+      name[DIR_NAME_LEN] = '\0';
+      memcpy(name, entries[k].name, DIR_NAME_LEN);
+      printf("ENTRY %s: inode %d\n", name, entries[k].inode_number);
+    }
+  }
+  printf("\n");
 }
 
 // Prints Disk state information
@@ -184,15 +1381,55 @@ void simplefs_dump() {
     printf("%c\t", superblock->datablock_freelist[i]);
   printf("\n");
 
+  // Only inodes in use are read, the in-core table tells which. The
+  // reclaimer waits until the dump is done
+  simplefs_lockMetadata();
+  if (!inode_table->loaded)
+    simplefs_loadInodeTable();
   struct inode_t *inode = (struct inode_t *)malloc(sizeof(struct inode_t));
   for (int i = 0; i < NUM_INODES; i++) {
+    if (inode_table->status[i] != INODE_IN_USE)
+      continue;
     simplefs_readInode(i, inode);
     if (inode->status == INODE_IN_USE) {
+      memcpy(buf, inode->name, sizeof(buf) - 1);
       printf("INODE %d\nSTATUS:\t%c\tNAME\t%s\tSIZE\t%d\tDATABLOCK\t", i,
-             inode->status, inode->name, inode->file_size);
+             inode->status, buf, inode->file_size);
       for (int j = 0; j < MAX_FILE_SIZE; j++)
         printf("%d\t", inode->direct_blocks[j]);
       printf("\n");
+      // Directories are shown entry by entry
+      if (inode->flags & INODE_FLAG_DIR) {
+        simplefs_dumpDir(i, inode);
+        continue;
+      }
+      // Inline files carry their data in the inode
+      if ((inode->flags & INODE_FLAG_INLINE) && inode->file_size > 0) {
+        char tempBuf[INLINE_DATA_SIZE + 1];
+        tempBuf[INLINE_DATA_SIZE] = '\0';
+        memcpy(tempBuf, inode->inline_data, INLINE_DATA_SIZE);
+        printf("INLINE DATA: %s\n\n", tempBuf);
+        continue;
+      }
+      // Compressed files are shown chunk by chunk, decompressed
+      if (DISK_FEATURES & FEATURE_COMPRESSION) {
+        struct chunk_t chunks[MAX_FILE_SIZE];
+        simplefs_readChunkMap(i, chunks);
+        printf("CHUNKS\t");
+        for (int j = 0; j < MAX_FILE_SIZE; j++)
+          printf("%d:%d\t", chunks[j].offset, chunks[j].length);
+        printf("\n");
+        for (int j = 0; j < MAX_FILE_SIZE; j++) {
+          if (chunks[j].length == 0)
+            continue;
+          char tempBuf[BLOCKSIZE + 1];
+          tempBuf[BLOCKSIZE] = '\0';
+          simplefs_readChunk(i, j, tempBuf);
+          printf("CHUNK %d: %s\n", j, tempBuf);
+        }
+        printf("\n");
+        continue;
+      }
       for (int j = 0; j < MAX_FILE_SIZE; j++) {
         if (inode->direct_blocks[j] != -1) {
           char tempBuf[BLOCKSIZE + 1];
@@ -204,6 +1441,7 @@ void simplefs_dump() {
       printf("\n");
     }
   }
+  simplefs_unlockMetadata();
   free(inode);
   free(superblock);
 
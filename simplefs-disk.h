@@ -1,54 +1,223 @@
-// DISK EMULATION
-#include <assert.h>
-#include <fcntl.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <sys/stat.h>
-#include <sys/types.h>
-#include <unistd.h>
-
-#define BLOCKSIZE 64
-#define NUM_BLOCKS 35
-#define NUM_DATA_BLOCKS 30
-#define NUM_INODE_BLOCKS 4
-#define NUM_INODES 8
-#define NUM_INODES_PER_BLOCK 2
-#define MAX_FILE_SIZE 4 // In Blocks
-#define MAX_FILES 8
-#define MAX_OPEN_FILES 20
-#define MAX_NAME_STRLEN 8
-#define INODE_FREE 'x'
-#define INODE_IN_USE '1'
-#define DATA_BLOCK_FREE 'x'
-#define DATA_BLOCK_USED '1'
-
-struct superblock_t {
-  char name[MAX_NAME_STRLEN];      // "simplefs" after formatting
-  char inode_freelist[NUM_INODES]; // INODE_FREE if free, INODE_IN_USE if used
-  char datablock_freelist[NUM_DATA_BLOCKS]; // DATA_BLOCK_FREE if free,
-                                            // DATA_BLOCK_USED if used
-};
-
-struct inode_t {
-  int status;                       // INODE_FREE if free, INODE_IN_USE if used
-  char name[MAX_NAME_STRLEN];       // name of the file
-  int file_size;                    // size of the file in bytes
-  int direct_blocks[MAX_FILE_SIZE]; // -1 if free, block number if used
-};
-
-struct filehandle_t {
-  int offset;       // current offset in opened file
-  int inode_number; // Inode number for the file
-};
-
-void simplefs_formatDisk();
-int simplefs_allocInode();
-void simplefs_freeInode(int inodenum);
-void simplefs_readInode(int inodenum, struct inode_t *inodeptr);
-void simplefs_writeInode(int inodenum, struct inode_t *inodeptr);
-int simplefs_allocDataBlock();
-void simplefs_freeDataBlock(int blocknum);
-void simplefs_readDataBlock(int blocknum, char *buf);
-void simplefs_writeDataBlock(int blocknum, char *buf);
-void simplefs_dump();
+// DISK EMULATION
+#ifndef SIMPLEFS_DISK_H
+#define SIMPLEFS_DISK_H
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#define BLOCKSIZE 64
+#define NUM_BLOCKS 59
+#define NUM_DATA_BLOCKS 30
+#define NUM_INODE_BLOCKS 8
+#define DATA_BLOCK_START 9 // After superblock and inode blocks
+#define CHUNK_MAP_START 39 // After data blocks
+#define NUM_CHUNK_MAP_BLOCKS 2
+#define SNAPSHOT_START 41 // After chunk maps, NUM_INODE_BLOCKS per snapshot
+#define NUM_SNAPSHOTS 2
+#define CHECKSUM_START 57 // After snapshots, CRC32C of each data block
+#define NUM_CHECKSUM_BLOCKS 2
+#define SEGMENT_BLOCKS 5 // Data blocks per log segment
+#define LOG_HEAD_START 1 // FEATURE_LOG: log head, in the unused inode blocks
+#define NUM_SEGMENTS (NUM_DATA_BLOCKS / SEGMENT_BLOCKS)
+#define NUM_INODES 8
+#define NUM_INODES_PER_BLOCK 1
+#define MAX_FILE_SIZE 4 // In Blocks
+#define MAX_FILES 8
+#define MAX_OPEN_FILES 20
+#define MAX_NAME_STRLEN 8
+#define INODE_FREE 'x'
+#define INODE_IN_USE '1'
+#define INODE_ORPHAN 'o' // Deleted, blocks not reclaimed yet
+#define DATA_BLOCK_FREE 'x'
+#define DATA_BLOCK_USED '1'
+#define MAX_BLOCK_REFS 9 // Shared blocks count users from '1' up to '9'
+#define SNAPSHOT_FREE 'x'
+#define SNAPSHOT_IN_USE '1'
+#define INODE_FLAG_INLINE 0x1 // File data stored in `inline_data`
+#define INODE_FLAG_DIR 0x2    // Directory, its data are struct dirent_t slots
+#define INODE_FLAG_CHILD 0x4  // Entry of a directory rather than of the root
+#define INLINE_DATA_SIZE 28   // Bytes of data that fit inside the inode
+#define FEATURE_COMPRESSION 0x1 // File data stored as compressed chunks
+#define FEATURE_LOG 0x2         // Data and inodes appended to a log
+#define FEATURE_CHECKSUM 0x4    // Data blocks checked on every read
+#define OPEN_APPEND 0x1         // Every write goes to the end of file
+#define DIR_NAME_LEN 24         // Longest name inside a directory
+#define DIRENTS_PER_BLOCK 2
+#define DIRENT_EMPTY 0          // Slot never used, ends a lookup
+#define DIRENT_IN_USE '1'
+#define DIRENT_DELETED 'd'      // Slot freed, lookups go on past it
+
+struct superblock_t {
+  char name[MAX_NAME_STRLEN];      // "simplefs" after formatting
+  char inode_freelist[NUM_INODES]; // INODE_FREE if free, INODE_IN_USE if used
+  char datablock_freelist[NUM_DATA_BLOCKS]; // DATA_BLOCK_FREE if free,
+                                            // DATA_BLOCK_USED if used, one
+                                            // more per extra user if shared
+  char features;                 // FEATURE_* flags chosen at format time
+  char snapshots[NUM_SNAPSHOTS]; // SNAPSHOT_FREE or SNAPSHOT_IN_USE
+  char inode_map[NUM_INODES];    // FEATURE_LOG: data block holding the
+                                 // latest copy of each inode, -1 if none
+  char free_inodes;              // INODE_FREE entries of `inode_freelist`
+  char free_blocks;              // DATA_BLOCK_FREE entries of
+                                 // `datablock_freelist`
+  char stripe_members;           // image files the data blocks are striped
+                                 // over, 1 if not striped
+  char stripe_unit;              // consecutive data blocks per member
+  char stripe_index;             // place of this image in the set
+  short stripe_set;              // same on every member of a set
+};
+static_assert(sizeof(struct superblock_t) <= BLOCKSIZE,
+              "superblock_t must fit in a block");
+
+struct inode_t {
+  int status;                       // INODE_FREE if free, INODE_IN_USE if used
+  char name[MAX_NAME_STRLEN];       // name of the file, only its start for
+                                    // entries of directories
+  int file_size;                    // size of the file in bytes
+  int direct_blocks[MAX_FILE_SIZE]; // -1 if free, block number if used
+  int flags;                        // INODE_FLAG_* flags
+  char inline_data[INLINE_DATA_SIZE]; // contents if INODE_FLAG_INLINE is set
+};
+static_assert(sizeof(struct inode_t) == BLOCKSIZE / NUM_INODES_PER_BLOCK,
+              "inode_t must fill its share of an inode block");
+
+// Slot of a directory. A name hashes to one of the directory's blocks and
+// takes the first free slot from there on
+struct dirent_t {
+  unsigned int hash;       // hash of `name`
+  short inode_number;      // inode the name refers to
+  char status;             // DIRENT_EMPTY, DIRENT_IN_USE or DIRENT_DELETED
+  char unused;
+  char name[DIR_NAME_LEN]; // NUL terminated unless it fills the field
+};
+static_assert(sizeof(struct dirent_t) == BLOCKSIZE / DIRENTS_PER_BLOCK,
+              "dirent_t must fill its share of a directory block");
+
+// Location of one BLOCKSIZE chunk of a compressed file inside the file's
+// packed data blocks
+struct chunk_t {
+  short offset; // byte offset of the chunk in the packed blocks
+  short length; // 0 if absent, BLOCKSIZE if stored uncompressed
+};
+
+// Run of data blocks [start, end) kept free for one inode's allocations
+struct window_t {
+  int start; // first reserved block
+  int end;   // one past the last reserved block, start if none
+};
+
+// In-core copy of the inode fields lookups and listings need, one array per
+// field so names are compared as 64-bit words, several per instruction
+struct inode_table_t {
+  int loaded;                   // 0 until read from disk
+  char status[NUM_INODES];      // INODE_FREE or INODE_IN_USE
+  uint64_t names[NUM_INODES];   // name up to its NUL, zero padded, the
+                                // start of it for entries of directories
+  int sizes[NUM_INODES];        // file_size
+  int flags[NUM_INODES];        // INODE_FLAG_* flags
+  int generations[NUM_INODES];  // bumped each time the inode is handed
+                                // out, and for all on format and mount
+};
+
+// Disk usage and fragmentation figures
+struct stats_t {
+  int files;              // inodes in use
+  int used_blocks;        // data blocks referenced by files
+  int extents;            // runs of consecutive data blocks over all files
+  float extents_per_file; // average extents per file, 1 if unfragmented
+};
+
+// Capacity and free space of the disk
+struct statfs_t {
+  int block_size;   // bytes per data block
+  int total_blocks; // data blocks
+  int free_blocks;  // data blocks free to allocate
+  int total_inodes;
+  int free_inodes;
+};
+
+// File listed by simplefs_list
+struct list_entry_t {
+  int inode_number;
+  char name[MAX_NAME_STRLEN + 1]; // start of the name for entries of
+                                  // directories
+  int size;                       // file_size
+  int flags;                      // INODE_FLAG_* flags
+};
+
+// What simplefs_stat reports of a file
+struct stat_t {
+  int inode_number;
+  int size;   // file_size
+  int blocks; // data blocks it holds
+  int flags;  // INODE_FLAG_* flags
+};
+
+struct filehandle_t {
+  int offset;       // current offset in opened file
+  int inode_number; // Inode number for the file
+  int snapshot;     // -1 for live files, else the read-only snapshot
+  int flags;        // OPEN_* flags the file was opened with
+};
+
+void simplefs_readSuperBlock(struct superblock_t *superblock);
+void simplefs_writeSuperBlock(struct superblock_t *superblock);
+void simplefs_formatDisk();
+void simplefs_formatDiskWithFeatures(int features);
+int simplefs_formatStripedDisk(int features, int members, int stripe_blocks);
+int simplefs_openDisk();
+int simplefs_mountDisk();
+int simplefs_allocInode();
+void simplefs_freeInode(int inodenum);
+int simplefs_reclaim();
+void simplefs_lockMetadata();
+void simplefs_unlockMetadata();
+int simplefs_readInode(int inodenum, struct inode_t *inodeptr);
+void simplefs_writeInode(int inodenum, struct inode_t *inodeptr);
+int simplefs_inodeOffset(int inodenum);
+int simplefs_findInode(char *filename);
+int simplefs_inodeFlags(int inodenum);
+int simplefs_inodeGeneration(int inodenum);
+void simplefs_invalidateInodeTable();
+void simplefs_shareMetadata(struct inode_table_t *table);
+void simplefs_beginBatch();
+void simplefs_endBatch();
+int simplefs_appendTail(int inodenum, char *buf, int nbytes);
+void simplefs_flushTail(int inodenum);
+int simplefs_allocDataBlock();
+int simplefs_allocDataBlockNear(int inodenum, int goal);
+void simplefs_setReservationWindow(int blocks);
+void simplefs_releaseWindow(int inodenum);
+void simplefs_freeDataBlock(int blocknum);
+int simplefs_reserveDataBlocks(int count);
+void simplefs_unreserveDataBlocks();
+int simplefs_allocDataBlocks(int count, int *blocknums);
+int simplefs_allocDataRun(int count, int limit);
+void simplefs_freeDataBlocks(int *blocknums, int count);
+int simplefs_shareDataBlocks(int *blocknums, int count);
+int simplefs_unshareDataBlock(int inodenum, int blocknum, int goal, int copy);
+int simplefs_dataBlockRefs(int blocknum);
+int simplefs_readDataBlock(int blocknum, char *buf);
+int simplefs_readDataBlocks(int blocknum, int count, char *buf);
+void simplefs_writeDataBlock(int blocknum, char *buf);
+void simplefs_writeDataBlocks(int blocknum, int count, char *buf);
+int simplefs_verifyDataBlock(int blocknum);
+void simplefs_readChunkMap(int inodenum, struct chunk_t *chunks);
+void simplefs_writeChunkMap(int inodenum, struct chunk_t *chunks);
+void simplefs_readSnapshotInode(int snapshot, int inodenum,
+                                struct inode_t *inodeptr);
+void simplefs_writeSnapshotInode(int snapshot, int inodenum,
+                                 struct inode_t *inodeptr);
+void simplefs_dump();
+void simplefs_getStats(struct stats_t *stats);
+void simplefs_statfs(struct statfs_t *statfs);
+int simplefs_list(int *cursor, struct list_entry_t *entries, int max);
+
+#endif
@@ -0,0 +1,294 @@
+#include "simplefs-fsck.h"
+#include "simplefs-dir.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+// pointer to simplefs.txt
+extern int DISK_FD;
+// FEATURE_* flags the disk was formatted with
+extern int DISK_FEATURES;
+
+#define METADATA_SIZE (DATA_BLOCK_START * BLOCKSIZE)
+#define CHUNK_MAP_SIZE (NUM_INODES * MAX_FILE_SIZE * sizeof(struct chunk_t))
+#define SNAPSHOT_SIZE (NUM_SNAPSHOTS * NUM_INODE_BLOCKS * BLOCKSIZE)
+
+// State shared by the checker threads
+struct fsck_state_t {
+  char metadata[METADATA_SIZE]; // superblock followed by the inode table
+  struct chunk_t chunks[NUM_INODES][MAX_FILE_SIZE];
+  struct inode_t snapshots[NUM_SNAPSHOTS][NUM_INODES];
+  atomic_int refs[NUM_DATA_BLOCKS]; // references from live inodes
+  int kept_refs[NUM_DATA_BLOCKS]; // references from snapshots and the
+                                  // inode map, left as they are
+  atomic_int bad_inodes;
+  int repair;
+};
+
+// Range of inodes [first, last) checked by one thread
+struct fsck_job_t {
+  struct fsck_state_t *state;
+  int first;
+  int last;
+};
+
+// Inode `inodenum` inside the metadata read by simplefs_fsck
+static struct inode_t *simplefs_fsckInode(struct fsck_state_t *state,
+                                          int inodenum) {
+  return (struct inode_t *)(state->metadata + BLOCKSIZE +
+                            inodenum * sizeof(struct inode_t));
+}
+
+// 1 if `inode` holds blocks, in use or deleted and waiting to be reclaimed
+static int simplefs_fsckLive(struct inode_t *inode) {
+  return inode->status == INODE_IN_USE || inode->status == INODE_ORPHAN;
+}
+
+// Check inodes [first, last) and mark the blocks they reference
+static void *simplefs_fsckWorker(void *arg) {
+  struct fsck_job_t *job = (struct fsck_job_t *)arg;
+  struct fsck_state_t *state = job->state;
+
+  for (int i = job->first; i < job->last; i++) {
+    struct inode_t *inode = simplefs_fsckInode(state, i);
+    if (!simplefs_fsckLive(inode))
+      continue;
+    int bad = 0;
+
+    // Size must fit the file, and inline data the inode
+    int max_size = inode->flags & INODE_FLAG_INLINE ? INLINE_DATA_SIZE
+                                                    : MAX_FILE_SIZE * BLOCKSIZE;
+    if (inode->file_size < 0 || inode->file_size > max_size) {
+      bad = 1;
+      if (state->repair)
+        inode->file_size = inode->file_size < 0 ? 0 : max_size;
+    }
+
+    // Block numbers must be on the disk, inline files have none
+    int blocks = 0;
+    for (int j = 0; j < MAX_FILE_SIZE; j++) {
+      int b = inode->direct_blocks[j];
+      if (b == -1)
+        continue;
+      if (b < -1 || b >= NUM_DATA_BLOCKS ||
+          (inode->flags & INODE_FLAG_INLINE)) {
+        bad = 1;
+        if (state->repair)
+          inode->direct_blocks[j] = -1;
+        continue;
+      }
+      blocks = j + 1;
+
+      // Count the reference
+      atomic_fetch_add(&state->refs[b], 1);
+    }
+
+    // Compressed chunks must lie inside the packed blocks
+    if (DISK_FEATURES & FEATURE_COMPRESSION) {
+      for (int j = 0; j < MAX_FILE_SIZE; j++) {
+        struct chunk_t *chunk = &state->chunks[i][j];
+        if (chunk->length == 0)
+          continue;
+        if (chunk->offset < 0 || chunk->length < 0 ||
+            chunk->length > BLOCKSIZE ||
+            chunk->offset + chunk->length > blocks * BLOCKSIZE) {
+          bad = 1;
+          if (state->repair)
+            chunk->offset = chunk->length = 0;
+        }
+      }
+    }
+    atomic_fetch_add(&state->bad_inodes, bad);
+  }
+  return NULL;
+}
+
+// Recorded number of users of data block `b`, 0 if free
+static int simplefs_fsckRecordedRefs(struct superblock_t *superblock, int b) {
+  char status = superblock->datablock_freelist[b];
+  return status == DATA_BLOCK_FREE ? 0 : status - '0';
+}
+
+// Check that the free maps match the blocks referenced by files and
+// snapshots, and that no block has more users than recorded, using
+// `nthreads` threads for the inodes. All metadata is read in one go. With
+// `repair` set, bad block numbers and sizes are dropped, extra users of a
+// block are dropped from the highest inodes, keeping snapshots, and the free
+// maps and their counts are rebuilt. Fills `report`, returns the number of
+// problems
+int simplefs_fsck(int nthreads, int repair, struct fsck_report_t *report) {
+  struct fsck_state_t *state =
+      (struct fsck_state_t *)calloc(1, sizeof(struct fsck_state_t));
+  struct superblock_t *superblock = (struct superblock_t *)state->metadata;
+  state->repair = repair;
+  memset(report, 0, sizeof(struct fsck_report_t));
+
+  // Read superblock, inode table and chunk maps with one call each, after
+  // writing back a cached append. The reclaimer waits until the end
+  simplefs_flushTail(-1);
+  simplefs_lockMetadata();
+  int ret = pread(DISK_FD, state->metadata, METADATA_SIZE, 0);
+  assert(ret == METADATA_SIZE);
+  if (DISK_FEATURES & FEATURE_COMPRESSION) {
+    ret = pread(DISK_FD, state->chunks, CHUNK_MAP_SIZE,
+                CHUNK_MAP_START * BLOCKSIZE);
+    assert(ret == CHUNK_MAP_SIZE);
+  }
+  ret = pread(DISK_FD, state->snapshots, SNAPSHOT_SIZE,
+              SNAPSHOT_START * BLOCKSIZE);
+  assert(ret == SNAPSHOT_SIZE);
+
+  // Log-structured disks keep each inode in the data block the inode map
+  // points at, read them into the inode table
+  if (DISK_FEATURES & FEATURE_LOG) {
+    for (int i = 0; i < NUM_INODES; i++) {
+      struct inode_t *inode = simplefs_fsckInode(state, i);
+      int b = superblock->inode_map[i];
+      memset(inode, 0, sizeof(struct inode_t));
+      inode->status = INODE_FREE;
+      if (b < -1 || b >= NUM_DATA_BLOCKS) {
+        report->inode_map_errors++;
+        superblock->inode_map[i] = -1;
+      } else if (b != -1) {
+        // An inode failing its checksum is bad, repairs drop it
+        char tempBuf[BLOCKSIZE];
+        if (simplefs_readDataBlock(b, tempBuf) == -1) {
+          atomic_fetch_add(&state->bad_inodes, 1);
+          superblock->inode_map[i] = -1;
+          continue;
+        }
+        memcpy(inode, tempBuf, sizeof(struct inode_t));
+        state->kept_refs[b]++;
+      }
+    }
+  }
+
+  // Count the blocks kept by snapshots, they are read-only and left as is
+  for (int s = 0; s < NUM_SNAPSHOTS; s++) {
+    if (superblock->snapshots[s] != SNAPSHOT_IN_USE)
+      continue;
+    for (int i = 0; i < NUM_INODES; i++) {
+      struct inode_t *inode = &state->snapshots[s][i];
+      if (inode->status != INODE_IN_USE)
+        continue;
+      for (int j = 0; j < MAX_FILE_SIZE; j++)
+        if (inode->direct_blocks[j] >= 0 &&
+            inode->direct_blocks[j] < NUM_DATA_BLOCKS)
+          state->kept_refs[inode->direct_blocks[j]]++;
+    }
+  }
+
+  // Check the inodes in parallel
+  if (nthreads < 1)
+    nthreads = 1;
+  if (nthreads > FSCK_MAX_THREADS)
+    nthreads = FSCK_MAX_THREADS;
+  if (nthreads > NUM_INODES)
+    nthreads = NUM_INODES;
+  pthread_t threads[FSCK_MAX_THREADS];
+  struct fsck_job_t jobs[FSCK_MAX_THREADS];
+  for (int t = 0; t < nthreads; t++) {
+    jobs[t].state = state;
+    jobs[t].first = NUM_INODES * t / nthreads;
+    jobs[t].last = NUM_INODES * (t + 1) / nthreads;
+    pthread_create(&threads[t], NULL, simplefs_fsckWorker, &jobs[t]);
+  }
+  for (int t = 0; t < nthreads; t++)
+    pthread_join(threads[t], NULL);
+  report->bad_inodes = state->bad_inodes;
+
+  // A block with more users than recorded is a duplicate. Snapshots use up
+  // the recorded users first, then the lowest inodes keep the rest
+  int refs[NUM_DATA_BLOCKS];
+  for (int b = 0; b < NUM_DATA_BLOCKS; b++) {
+    refs[b] = state->refs[b] + state->kept_refs[b];
+    int allowed = simplefs_fsckRecordedRefs(superblock, b);
+    if (allowed < 1)
+      allowed = 1;
+    if (refs[b] <= allowed)
+      continue;
+    report->duplicate_blocks++;
+    refs[b] = state->kept_refs[b];
+    for (int i = 0; i < NUM_INODES; i++) {
+      struct inode_t *inode = simplefs_fsckInode(state, i);
+      if (!simplefs_fsckLive(inode))
+        continue;
+      for (int j = 0; j < MAX_FILE_SIZE; j++) {
+        if (inode->direct_blocks[j] != b)
+          continue;
+        if (refs[b] < allowed)
+          refs[b]++;
+        else if (repair)
+          inode->direct_blocks[j] = -1;
+      }
+    }
+  }
+
+  // The free counts must match the free maps as recorded
+  int free_inodes = 0, free_blocks = 0;
+  for (int i = 0; i < NUM_INODES; i++)
+    free_inodes += superblock->inode_freelist[i] == INODE_FREE;
+  for (int b = 0; b < NUM_DATA_BLOCKS; b++)
+    free_blocks += superblock->datablock_freelist[b] == DATA_BLOCK_FREE;
+  report->inode_map_errors += superblock->free_inodes != free_inodes;
+  report->block_map_errors += superblock->free_blocks != free_blocks;
+
+  // Compare the free maps with what is in use
+  for (int i = 0; i < NUM_INODES; i++) {
+    char status = simplefs_fsckLive(simplefs_fsckInode(state, i))
+                      ? INODE_IN_USE
+                      : INODE_FREE;
+    if (superblock->inode_freelist[i] == status)
+      continue;
+    report->inode_map_errors++;
+    superblock->inode_freelist[i] = status;
+  }
+  for (int b = 0; b < NUM_DATA_BLOCKS; b++) {
+    if (refs[b] > MAX_BLOCK_REFS)
+      refs[b] = MAX_BLOCK_REFS;
+    char status = refs[b] ? '0' + refs[b] : DATA_BLOCK_FREE;
+    if (superblock->datablock_freelist[b] == status)
+      continue;
+    report->block_map_errors++;
+    superblock->datablock_freelist[b] = status;
+  }
+
+  // Recount the free entries of the rebuilt maps
+  superblock->free_inodes = 0;
+  for (int i = 0; i < NUM_INODES; i++)
+    superblock->free_inodes += superblock->inode_freelist[i] == INODE_FREE;
+  superblock->free_blocks = 0;
+  for (int b = 0; b < NUM_DATA_BLOCKS; b++)
+    superblock->free_blocks +=
+        superblock->datablock_freelist[b] == DATA_BLOCK_FREE;
+
+  // Write the repaired metadata back with one call each
+  int errors = report->bad_inodes + report->duplicate_blocks +
+               report->inode_map_errors + report->block_map_errors;
+  if (repair && errors > 0) {
+    ret = pwrite(DISK_FD, state->metadata, METADATA_SIZE, 0);
+    assert(ret == METADATA_SIZE);
+    if (DISK_FEATURES & FEATURE_LOG) {
+      for (int i = 0; i < NUM_INODES; i++) {
+        if (superblock->inode_map[i] == -1)
+          continue;
+        char tempBuf[BLOCKSIZE];
+        memset(tempBuf, 0, BLOCKSIZE);
+        memcpy(tempBuf, simplefs_fsckInode(state, i), sizeof(struct inode_t));
+        simplefs_writeDataBlock(superblock->inode_map[i], tempBuf);
+      }
+    }
+    if (DISK_FEATURES & FEATURE_COMPRESSION) {
+      ret = pwrite(DISK_FD, state->chunks, CHUNK_MAP_SIZE,
+                   CHUNK_MAP_START * BLOCKSIZE);
+      assert(ret == CHUNK_MAP_SIZE);
+    }
+    simplefs_invalidateInodeTable();
+    simplefs_invalidateDentries();
+    report->repaired = 1;
+  }
+
+  simplefs_unlockMetadata();
+  free(state);
+  return errors;
+}
@@ -0,0 +1,22 @@
+// CONSISTENCY CHECKER
+#ifndef SIMPLEFS_FSCK_H
+#define SIMPLEFS_FSCK_H
+
+#include "simplefs-disk.h"
+
+#define FSCK_MAX_THREADS 8
+
+// Problems found by simplefs_fsck
+struct fsck_report_t {
+  int bad_inodes;       // inodes with an invalid size, flag or block number
+  int duplicate_blocks; // data blocks with more users than recorded
+  int inode_map_errors; // `inode_freelist` entries not matching inode status,
+                        // or `free_inodes` not matching the entries
+  int block_map_errors; // `datablock_freelist` entries not matching use,
+                        // or `free_blocks` not matching the entries
+  int repaired;         // 1 if the problems were fixed on disk
+};
+
+int simplefs_fsck(int nthreads, int repair, struct fsck_report_t *report);
+
+#endif
@@ -0,0 +1,235 @@
+#include "simplefs-log.h"
+
+#include <pthread.h>
+#include <time.h>
+
+// FEATURE_* flags the disk was formatted with
+extern int DISK_FEATURES;
+// Next data block the log writes to
+extern int LOG_HEAD;
+// Segment the cleaner is emptying, the log skips it, -1 if none
+extern int LOG_CLEANING;
+
+// Cleaner thread
+static pthread_t cleaner;
+static pthread_mutex_t clean_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t clean_cond = PTHREAD_COND_INITIALIZER;
+static int cleaner_running;
+
+// Move live data block `blocknum` to the head of the log, handing its users
+// over to the copy. Returns -1 if it fails its checksum or the disk is full
+static int simplefs_moveDataBlock(int blocknum) {
+  char tempBuf[BLOCKSIZE];
+  if (simplefs_readDataBlock(blocknum, tempBuf) == -1)
+    return -1;
+  int newblock = simplefs_allocDataBlock();
+  if (newblock == -1)
+    return -1;
+  simplefs_writeDataBlock(newblock, tempBuf);
+
+  // The copy takes over the count of users
+  struct superblock_t *superblock =
+      (struct superblock_t *)malloc(sizeof(struct superblock_t));
+  simplefs_readSuperBlock(superblock);
+  superblock->datablock_freelist[newblock] =
+      superblock->datablock_freelist[blocknum];
+  superblock->datablock_freelist[blocknum] = DATA_BLOCK_FREE;
+  superblock->free_blocks++;
+  simplefs_writeSuperBlock(superblock);
+  free(superblock);
+
+  // Point every file using it at the copy
+  struct inode_t *inode = (struct inode_t *)malloc(sizeof(struct inode_t));
+  for (int i = 0; i < NUM_INODES; i++) {
+    simplefs_readInode(i, inode);
+    if (inode->status != INODE_IN_USE)
+      continue;
+    int changed = 0;
+    for (int j = 0; j < MAX_FILE_SIZE; j++) {
+      if (inode->direct_blocks[j] != blocknum)
+        continue;
+      inode->direct_blocks[j] = newblock;
+      changed = 1;
+    }
+    if (changed)
+      simplefs_writeInode(i, inode);
+  }
+  free(inode);
+  return 0;
+}
+
+// Empty segment `segment`, moving its live data blocks and inodes to the
+// head of the log. Returns -1 if the disk filled up first or a block fails
+// its checksum, it is then left where it is
+static int simplefs_cleanSegment(int segment) {
+  struct superblock_t *superblock =
+      (struct superblock_t *)malloc(sizeof(struct superblock_t));
+  struct inode_t *inode = (struct inode_t *)malloc(sizeof(struct inode_t));
+  int ret = 0;
+
+  LOG_CLEANING = segment;
+  for (int b = segment * SEGMENT_BLOCKS;
+       b < (segment + 1) * SEGMENT_BLOCKS && ret == 0; b++) {
+    simplefs_readSuperBlock(superblock);
+    if (superblock->datablock_freelist[b] == DATA_BLOCK_FREE)
+      continue;
+
+    // Inodes move by being written again
+    int inodenum = -1;
+    for (int i = 0; i < NUM_INODES; i++)
+      if (superblock->inode_map[i] == b)
+        inodenum = i;
+    if (inodenum != -1) {
+      if (simplefs_readInode(inodenum, inode) == -1) {
+        ret = -1;
+        continue;
+      }
+      simplefs_writeInode(inodenum, inode);
+      simplefs_readSuperBlock(superblock);
+      if (superblock->inode_map[inodenum] == b)
+        ret = -1;
+      continue;
+    }
+    ret = simplefs_moveDataBlock(b);
+  }
+  LOG_CLEANING = -1;
+
+  free(inode);
+  free(superblock);
+  return ret;
+}
+
+// Reclaim free space on a log-structured disk by emptying up to
+// `max_segments` segments, so the log keeps writing whole segments in order.
+// Segments with the fewest live blocks go first, only if the live blocks fit
+// elsewhere. Meant to be called when the disk is idle, like simplefs_defrag,
+// or left to the cleaner thread. Returns the number of segments emptied, 0
+// once there is nothing to gain
+int simplefs_clean(int max_segments) {
+  if (!(DISK_FEATURES & FEATURE_LOG))
+    return 0;
+
+  // Blocks of deleted files are freed first, the moves only update live files
+  simplefs_lockMetadata();
+  simplefs_reclaim();
+  struct superblock_t *superblock =
+      (struct superblock_t *)malloc(sizeof(struct superblock_t));
+  int cleaned = 0;
+  while (cleaned < max_segments) {
+    simplefs_readSuperBlock(superblock);
+
+    // The segment being filled is left alone
+    int filling = LOG_HEAD % SEGMENT_BLOCKS != 0 ? LOG_HEAD / SEGMENT_BLOCKS
+                                                 : -1;
+
+    // Pick the segment with fewest live blocks that has some free ones
+    int victim = -1, victim_live = SEGMENT_BLOCKS, free_blocks = 0;
+    for (int s = 0; s < NUM_SEGMENTS; s++) {
+      int live = 0;
+      for (int i = 0; i < SEGMENT_BLOCKS; i++)
+        live += superblock->datablock_freelist[s * SEGMENT_BLOCKS + i] !=
+                DATA_BLOCK_FREE;
+      free_blocks += SEGMENT_BLOCKS - live;
+      if (s != filling && live > 0 && live < victim_live) {
+        victim = s;
+        victim_live = live;
+      }
+    }
+
+    // Its live blocks have to fit outside it, each may rewrite an inode too
+    if (victim == -1 ||
+        2 * victim_live > free_blocks - (SEGMENT_BLOCKS - victim_live))
+      break;
+    if (simplefs_cleanSegment(victim) == -1)
+      break;
+    cleaned++;
+  }
+
+  free(superblock);
+  simplefs_unlockMetadata();
+  return cleaned;
+}
+
+// Wait out CLEAN_INTERVAL_US, or until the cleaner is stopped. The caller
+// holds the clean lock
+static void simplefs_cleanPause() {
+  struct timespec until;
+  clock_gettime(CLOCK_REALTIME, &until);
+  long nsec = until.tv_nsec + CLEAN_INTERVAL_US * 1000L;
+  until.tv_sec += nsec / 1000000000L;
+  until.tv_nsec = nsec % 1000000000L;
+  while (cleaner_running &&
+         pthread_cond_timedwait(&clean_cond, &clean_lock, &until) == 0)
+    ;
+}
+
+// Number of segments without live blocks
+static int simplefs_countCleanSegments() {
+  struct superblock_t *superblock =
+      (struct superblock_t *)malloc(sizeof(struct superblock_t));
+  simplefs_readSuperBlock(superblock);
+  int count = 0;
+  for (int s = 0; s < NUM_SEGMENTS; s++) {
+    int clean = 1;
+    for (int i = 0; i < SEGMENT_BLOCKS && clean; i++)
+      clean = superblock->datablock_freelist[s * SEGMENT_BLOCKS + i] ==
+              DATA_BLOCK_FREE;
+    count += clean;
+  }
+  free(superblock);
+  return count;
+}
+
+// Empty a segment while fewer than CLEAN_MIN_SEGMENTS are clean, then pause
+// for CLEAN_INTERVAL_US whatever it found, so writes only ever wait for one
+// segment and the cleaner keeps to its pace
+static void *simplefs_cleanerThread(void *arg) {
+  (void)arg;
+  pthread_mutex_lock(&clean_lock);
+  while (cleaner_running) {
+    pthread_mutex_unlock(&clean_lock);
+    simplefs_lockMetadata();
+    if (simplefs_countCleanSegments() < CLEAN_MIN_SEGMENTS)
+      simplefs_clean(1);
+    simplefs_unlockMetadata();
+    pthread_mutex_lock(&clean_lock);
+    simplefs_cleanPause();
+  }
+  pthread_mutex_unlock(&clean_lock);
+  return NULL;
+}
+
+// Start cleaning segments of a log-structured disk in the background, until
+// simplefs_stopCleaner, so foreground writes find CLEAN_MIN_SEGMENTS clean
+// segments without calling simplefs_clean. Returns -1 if it is already
+// running, the disk isn't log-structured or the thread can't be started
+int simplefs_startCleaner() {
+  if (!(DISK_FEATURES & FEATURE_LOG))
+    return -1;
+  pthread_mutex_lock(&clean_lock);
+  if (cleaner_running) {
+    pthread_mutex_unlock(&clean_lock);
+    return -1;
+  }
+  cleaner_running = 1;
+  if (pthread_create(&cleaner, NULL, simplefs_cleanerThread, NULL)) {
+    cleaner_running = 0;
+    pthread_mutex_unlock(&clean_lock);
+    return -1;
+  }
+  pthread_mutex_unlock(&clean_lock);
+  return 0;
+}
+
+// Stop the cleaner, segments are only cleaned by simplefs_clean again
+void simplefs_stopCleaner() {
+  pthread_mutex_lock(&clean_lock);
+  if (!cleaner_running) {
+    pthread_mutex_unlock(&clean_lock);
+    return;
+  }
+  cleaner_running = 0;
+  pthread_cond_signal(&clean_cond);
+  pthread_mutex_unlock(&clean_lock);
+  pthread_join(cleaner, NULL);
+}
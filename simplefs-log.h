@@ -0,0 +1,14 @@
+// LOG-STRUCTURED LAYOUT
+#ifndef SIMPLEFS_LOG_H
+#define SIMPLEFS_LOG_H
+
+#include "simplefs-disk.h"
+
+#define CLEAN_INTERVAL_US 10000 // Pause of the cleaner after each segment
+#define CLEAN_MIN_SEGMENTS 2    // Clean segments the cleaner keeps free
+
+int simplefs_clean(int max_segments);
+int simplefs_startCleaner();
+void simplefs_stopCleaner();
+
+#endif
@@ -1,31 +1,51 @@
 #include "simplefs-ops.h"
+#include "simplefs-compress.h"
+#include "simplefs-dir.h"
+#include "simplefs-reclaim.h"
+#include "simplefs-view.h"
+
+#include <pthread.h>
 
 // Array for storing opened files
 extern struct filehandle_t file_handle_array[MAX_OPEN_FILES];
-
-// Create file with name `filename` from disk
-int simplefs_create(char *filename) {
-  struct inode_t *inode = (struct inode_t *)malloc(sizeof(struct inode_t));
-  int inodenum;
-
-  // Iterate thru all inodes
-  for (inodenum = 0; inodenum < NUM_INODES; inodenum++) {
-    // Read the inode
+// FEATURE_* flags the disk was formatted with
+extern int DISK_FEATURES;
+// Set once a data block may be shared, so writes check for copy-on-write
+extern int DISK_SHARING;
+// Serializes writes through OPEN_APPEND handles
+static pthread_mutex_t append_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Read the inode behind `file_handle`, from its snapshot if it has one
+static void simplefs_readHandleInode(int file_handle, struct inode_t *inode) {
+  int inodenum = file_handle_array[file_handle].inode_number;
+  int snapshot = file_handle_array[file_handle].snapshot;
+  if (snapshot == -1)
     simplefs_readInode(inodenum, inode);
+  else
+    simplefs_readSnapshotInode(snapshot, inodenum, inode);
+}
 
-    // If already free, ignore it
-    if (inode->status == INODE_FREE)
-      continue;
-
-    // If not free then check if the name matches
-    if (!strcmp(inode->name, filename)) {
-      free(inode);
+// Create file with name `filename` from disk, a path with '/' creates it in
+// a directory
+int simplefs_create(char *filename) {
+  // Paths go to the directory layer
+  if (strchr(filename, '/')) {
+    if (simplefs_lookupPath(filename) != -1)
       return 1;
-    }
+    return simplefs_createEntry(filename, INODE_FLAG_INLINE);
   }
 
+  // Names have to fit the inode
+  if (strlen(filename) > MAX_NAME_STRLEN)
+    return -1;
+
+  // If the name is taken, do nothing
+  if (simplefs_findInode(filename) != -1)
+    return 1;
+
   // Allocate inode if it is feasible
-  inodenum = simplefs_allocInode();
+  struct inode_t *inode = (struct inode_t *)malloc(sizeof(struct inode_t));
+  int inodenum = simplefs_allocInode();
   if (inodenum == -1) {
     free(inode); // Free malloced data
     return -1;
@@ -36,7 +56,12 @@ int simplefs_create(char *filename) {
   inode->file_size = 0;
   for (int i = 0; i < MAX_FILE_SIZE; i++)
     inode->direct_blocks[i] = -1;
-  strcpy(inode->name, filename);
+  memset(inode->name, 0, MAX_NAME_STRLEN);
+  memcpy(inode->name, filename, strlen(filename));
+
+  // New files start out with their data inline
+  inode->flags = INODE_FLAG_INLINE;
+  memset(inode->inline_data, 0, INLINE_DATA_SIZE);
 
   // Write the inode
   simplefs_writeInode(inodenum, inode);
@@ -45,67 +70,44 @@ int simplefs_create(char *filename) {
   return inodenum;
 }
 
-// delete file with name `filename` from disk
+// delete file or empty directory with name or path `filename` from disk
 void simplefs_delete(char *filename) {
-  struct inode_t *inode = (struct inode_t *)malloc(sizeof(struct inode_t));
-  int inodenum;
-
-  // Iterate thru all inodes
-  for (inodenum = 0; inodenum < NUM_INODES; inodenum++) {
-    // Read the inode
-    simplefs_readInode(inodenum, inode);
-
-    // If already free, ignore it
-    if (inode->status == INODE_FREE)
-      continue;
-
-    // If not free then check if the name matches
-    if (!strcmp(inode->name, filename)) {
-      break;
-    }
-  }
-
   // If match not found, do nothing
-  if (inodenum == NUM_BLOCKS) {
-    free(inode); // Free malloced data
+  int inodenum = simplefs_lookupPath(filename);
+  if (inodenum == -1)
     return;
-  }
 
-  // If match found then free data blocks and inode itself
-  for (int j = 0; j < MAX_FILE_SIZE; j++) {
-    if (inode->direct_blocks[j] == -1)
-      continue;
-    simplefs_freeDataBlock(inode->direct_blocks[j]);
-  }
-  simplefs_freeInode(inodenum);
+  // Directories have to be empty, then the entry leaves its directory
+  if ((simplefs_inodeFlags(inodenum) & INODE_FLAG_DIR) &&
+      !simplefs_dirEmpty(inodenum))
+    return;
+  if (simplefs_privatizeMappings(inodenum) == -1)
+    return;
+  simplefs_unlinkPath(filename);
+
+  // Leave the inode as an orphan for the background reclaimer, which frees
+  // the blocks of many deleted files at once. Without it they are freed now
+  struct inode_t *inode = (struct inode_t *)malloc(sizeof(struct inode_t));
+  simplefs_lockMetadata();
+  simplefs_readInode(inodenum, inode);
+  inode->status = INODE_ORPHAN;
+  simplefs_writeInode(inodenum, inode);
+  simplefs_unlockMetadata();
+  simplefs_releaseWindow(inodenum);
+  if (DISK_FEATURES & FEATURE_COMPRESSION)
+    simplefs_invalidateChunks(inodenum);
+  if (!simplefs_queueReclaim())
+    simplefs_reclaim();
 
   free(inode); // Free malloced data
   return;
 }
 
-// open file with name `filename`
+// open file with name or path `filename`
 int simplefs_open(char *filename) {
-  struct inode_t *inode = (struct inode_t *)malloc(sizeof(struct inode_t));
-  int inodenum;
-
-  // Iterate thru all inodes
-  for (inodenum = 0; inodenum < NUM_INODES; inodenum++) {
-    // Read the inode
-    simplefs_readInode(inodenum, inode);
-
-    // If already free, ignore it
-    if (inode->status == INODE_FREE)
-      continue;
-
-    // If not free then check if the name matches
-    if (!strcmp(inode->name, filename)) {
-      break;
-    }
-  }
-  free(inode); // Free malloced data
-
-  // If match not found, do nothing
-  if (inodenum == NUM_BLOCKS)
+  // If match not found or it is a directory, do nothing
+  int inodenum = simplefs_lookupPath(filename);
+  if (inodenum == -1 || (simplefs_inodeFlags(inodenum) & INODE_FLAG_DIR))
     return -1;
 
   // Check free file handle and assign it
@@ -115,6 +117,8 @@ int simplefs_open(char *filename) {
       continue;
     file_handle_array[file_handle].inode_number = inodenum;
     file_handle_array[file_handle].offset = 0;
+    file_handle_array[file_handle].snapshot = -1;
+    file_handle_array[file_handle].flags = 0;
     break;
   }
 
@@ -126,32 +130,56 @@ int simplefs_open(char *filename) {
   return file_handle;
 }
 
+// open file with name `filename` for appending, every write through the
+// handle goes to the end of file
+int simplefs_open_append(char *filename) {
+  int file_handle = simplefs_open(filename);
+  if (file_handle != -1)
+    file_handle_array[file_handle].flags = OPEN_APPEND;
+  return file_handle;
+}
+
 // close file pointed by `file_handle`
 void simplefs_close(int file_handle) {
   // Check if the file handle is feasible
   if (file_handle >= MAX_OPEN_FILES)
     return;
 
+  // Write back what was appended through it
+  if (file_handle_array[file_handle].flags & OPEN_APPEND) {
+    pthread_mutex_lock(&append_lock);
+    simplefs_flushTail(file_handle_array[file_handle].inode_number);
+    pthread_mutex_unlock(&append_lock);
+  }
+
   // Reset the file handle
   file_handle_array[file_handle].inode_number = -1;
   file_handle_array[file_handle].offset = 0;
+  file_handle_array[file_handle].snapshot = -1;
+  file_handle_array[file_handle].flags = 0;
   return;
 }
 
 // read `nbytes` of data into `buf` from file pointed by `file_handle`
 // starting at current offset
 int simplefs_read(int file_handle, char *buf, int nbytes) {
+  return simplefs_pread(file_handle, buf, nbytes,
+                        file_handle_array[file_handle].offset);
+}
+
+// read `nbytes` of data into `buf` from file pointed by `file_handle`
+// starting at `offset`, leaving the handle offset alone
+int simplefs_pread(int file_handle, char *buf, int nbytes, int offset) {
   // If nbytes isn't positive, it is invalid
-  if (nbytes <= 0)
+  if (nbytes <= 0 || offset < 0)
     return -1;
 
-  // Get the offset and the inode number
-  int offset = file_handle_array[file_handle].offset;
+  // Get the inode number
   int inodenum = file_handle_array[file_handle].inode_number;
   struct inode_t *inode = (struct inode_t *)malloc(sizeof(struct inode_t));
 
   // Read the inode
-  simplefs_readInode(inodenum, inode);
+  simplefs_readHandleInode(file_handle, inode);
 
   // If read crosses boundary, do nothing
   if (inode->file_size < offset + nbytes) {
@@ -159,92 +187,292 @@ int simplefs_read(int file_handle, char *buf, int nbytes) {
     return -1;
   }
 
-  char tempBlockBuf[BLOCKSIZE];
-  int tempset = 0;
-  // Iterate over all possible data blocks
-  for (int i = 0; i < NUM_DATA_BLOCKS; i++) {
-    // If found an allocated block, break loop
-    if (inode->direct_blocks[i] == -1)
-      break;
+  int ret = simplefs_readFile(inodenum, inode, offset, buf, nbytes);
+  free(inode); // Free malloced data
+  return ret;
+}
+
+// read `nbytes` of data into `buf` from inode `inodenum`, already read into
+// `inode`, starting at `offset`
+int simplefs_readFile(int inodenum, struct inode_t *inode, int offset,
+                      char *buf, int nbytes) {
+  // Inline files are served from the inode itself
+  if (inode->flags & INODE_FLAG_INLINE) {
+    memcpy(buf, inode->inline_data + offset, nbytes);
+    return 0;
+  }
 
-    // If end is before the block, break loop
-    if (offset + nbytes < i * BLOCKSIZE)
-      break;
+  // Compressed files go through the chunk layer
+  if (DISK_FEATURES & FEATURE_COMPRESSION)
+    return simplefs_readCompressed(inodenum, inode, offset, buf, nbytes);
 
-    // If we don't need this block then skip
-    if (offset + tempset > (i + 1) * BLOCKSIZE)
+  char tempBlockBuf[BLOCKSIZE];
+  int tempset = 0;
+  // Iterate over the data blocks covering the range
+  for (int i = offset / BLOCKSIZE; tempset < nbytes; i++) {
+    // Set ls as left side diff and len as the bytes used from this block
+    int ls = offset + tempset - i * BLOCKSIZE;
+    int len = BLOCKSIZE - ls;
+    if (len > nbytes - tempset)
+      len = nbytes - tempset;
+
+    // Holes read as zeros, without touching the disk
+    if (inode->direct_blocks[i] == -1) {
+      memset(buf + tempset, 0, len);
+      tempset += len;
       continue;
+    }
 
-    // Set ls as left side diff and rs as right side diff
-    int ls = offset - (i * BLOCKSIZE);
-    int rs = (i + 1) * BLOCKSIZE - (offset + nbytes);
-    if (ls < 0)
-      ls = 0;
-    if (rs < 0)
-      rs = 0;
+    // Whole blocks that are consecutive on disk are read in one go, straight
+    // into `buf`
+    if (len == BLOCKSIZE) {
+      int run = 1;
+      while (i + run < MAX_FILE_SIZE &&
+             (run + 1) * BLOCKSIZE <= nbytes - tempset &&
+             inode->direct_blocks[i + run] == inode->direct_blocks[i] + run)
+        run++;
+      if (simplefs_readDataBlocks(inode->direct_blocks[i], run,
+                                  buf + tempset) == -1)
+        return -1;
+      tempset += run * BLOCKSIZE;
+      i += run - 1;
+      continue;
+    }
 
     // Read the data block
-    simplefs_readDataBlock(inode->direct_blocks[i], tempBlockBuf);
+    if (simplefs_readDataBlock(inode->direct_blocks[i], tempBlockBuf) == -1)
+      return -1;
 
     // Copy the required portion of the data block
-    memcpy(buf + tempset, tempBlockBuf + ls, BLOCKSIZE - ls - rs);
+    memcpy(buf + tempset, tempBlockBuf + ls, len);
 
     // Update the tempset
-    tempset += BLOCKSIZE - ls - rs;
+    tempset += len;
   }
 
-  free(inode); // Free malloced data
   return 0;
 }
 
+// Append `nbytes` of data from `buf` to the end of inode `inodenum`, as one
+// step for all appending handles, of other attached processes too. Small
+// appends only fill the cached last block, which is written once full
+static int simplefs_append(int inodenum, char *buf, int nbytes) {
+  // If nbytes isn't positive, it is invalid
+  if (nbytes <= 0)
+    return -1;
+
+  pthread_mutex_lock(&append_lock);
+  simplefs_lockMetadata();
+  int ret = simplefs_appendTail(inodenum, buf, nbytes);
+  if (ret == -1) {
+    // Otherwise write at the end of file like any other write
+    struct inode_t *inode = (struct inode_t *)malloc(sizeof(struct inode_t));
+    ret = simplefs_readInode(inodenum, inode);
+    if (ret == 0)
+      ret = simplefs_writeFile(inodenum, inode, inode->file_size, buf, nbytes);
+    free(inode); // Free malloced data
+  }
+  simplefs_unlockMetadata();
+  pthread_mutex_unlock(&append_lock);
+  return ret;
+}
+
 // write `nbytes` of data from `buf` to file pointed by `file_handle`
-// starting at current offset
+// starting at current offset, or at end of file for OPEN_APPEND handles
 int simplefs_write(int file_handle, char *buf, int nbytes) {
+  if (file_handle_array[file_handle].flags & OPEN_APPEND)
+    return simplefs_append(file_handle_array[file_handle].inode_number, buf,
+                           nbytes);
+  return simplefs_pwrite(file_handle, buf, nbytes,
+                         file_handle_array[file_handle].offset);
+}
+
+// write `nbytes` of data from `buf` to file pointed by `file_handle`
+// starting at `offset`, leaving the handle offset alone
+int simplefs_pwrite(int file_handle, char *buf, int nbytes, int offset) {
   // If nbytes isn't positive, it is invalid
-  if (nbytes <= 0)
+  if (nbytes <= 0 || offset < 0)
     return -1;
 
-  // Get the offset and the inode number
-  int offset = file_handle_array[file_handle].offset;
+  // Snapshots are read-only
+  if (file_handle_array[file_handle].snapshot != -1)
+    return -1;
+
+  // Get the inode number
   int inodenum = file_handle_array[file_handle].inode_number;
   struct inode_t *inode = (struct inode_t *)malloc(sizeof(struct inode_t));
 
-  // Read the inode
-  simplefs_readInode(inodenum, inode);
+  // Read the inode and write the file under the metadata lock, so defrag
+  // can't move the blocks written to in between
+  simplefs_lockMetadata();
+  int ret = simplefs_readInode(inodenum, inode);
+  if (ret == 0)
+    ret = simplefs_writeFile(inodenum, inode, offset, buf, nbytes);
+  simplefs_unlockMetadata();
+  free(inode); // Free malloced data
+  return ret;
+}
+
+// Total length of the `iovcnt` buffers in `iov`, -1 if it is not positive or
+// more than a file can hold
+static int simplefs_iovLength(const struct iovec *iov, int iovcnt) {
+  if (iovcnt <= 0)
+    return -1;
+  long total = 0;
+  for (int i = 0; i < iovcnt; i++)
+    total += iov[i].iov_len;
+  if (total <= 0 || total > MAX_FILE_SIZE * BLOCKSIZE)
+    return -1;
+  return total;
+}
+
+// read into the `iovcnt` buffers of `iov` in turn from file pointed by
+// `file_handle` starting at current offset. The whole range is read in one
+// pass over the file's blocks
+int simplefs_readv(int file_handle, const struct iovec *iov, int iovcnt) {
+  int nbytes = simplefs_iovLength(iov, iovcnt);
+  if (nbytes == -1)
+    return -1;
+
+  // Read the range at once, then hand it out to the buffers
+  char tempBuf[MAX_FILE_SIZE * BLOCKSIZE];
+  if (simplefs_read(file_handle, tempBuf, nbytes) == -1)
+    return -1;
+  for (int i = 0, tempset = 0; i < iovcnt; i++) {
+    memcpy(iov[i].iov_base, tempBuf + tempset, iov[i].iov_len);
+    tempset += iov[i].iov_len;
+  }
+  return 0;
+}
+
+// write the `iovcnt` buffers of `iov` in turn to file pointed by
+// `file_handle` starting at current offset. The inode and each block are
+// written once for the whole range
+int simplefs_writev(int file_handle, const struct iovec *iov, int iovcnt) {
+  int nbytes = simplefs_iovLength(iov, iovcnt);
+  if (nbytes == -1)
+    return -1;
+
+  // Gather the buffers, then write the range at once
+  char tempBuf[MAX_FILE_SIZE * BLOCKSIZE];
+  for (int i = 0, tempset = 0; i < iovcnt; i++) {
+    memcpy(tempBuf + tempset, iov[i].iov_base, iov[i].iov_len);
+    tempset += iov[i].iov_len;
+  }
+  return simplefs_write(file_handle, tempBuf, nbytes);
+}
+
+// Move the inline data of inode `inodenum` into data blocks
+static int simplefs_promoteInline(int inodenum, struct inode_t *inode) {
+  char tempBuf[INLINE_DATA_SIZE];
+  int size = inode->file_size;
+  memcpy(tempBuf, inode->inline_data, INLINE_DATA_SIZE);
+
+  // Turn it into an empty regular file
+  inode->flags &= ~INODE_FLAG_INLINE;
+  memset(inode->inline_data, 0, INLINE_DATA_SIZE);
+  inode->file_size = 0;
+  if (size == 0)
+    return 0;
+
+  // Write the old contents back through the block path
+  if (simplefs_writeFile(inodenum, inode, 0, tempBuf, size) == -1) {
+    inode->flags |= INODE_FLAG_INLINE;
+    memcpy(inode->inline_data, tempBuf, INLINE_DATA_SIZE);
+    inode->file_size = size;
+    return -1;
+  }
+  return 0;
+}
 
+// write `nbytes` of data from `buf` to inode `inodenum`, already read into
+// `inode`, starting at `offset`
+int simplefs_writeFile(int inodenum, struct inode_t *inode, int offset,
+                       char *buf, int nbytes) {
   // Compute the required blocks
   int req_blocks = (offset + nbytes - 1) / BLOCKSIZE + 1;
 
   // If read crosses boundary, do nothing
-  if (req_blocks > MAX_FILE_SIZE) {
-    free(inode); // Free malloced data
+  if (req_blocks > MAX_FILE_SIZE)
     return -1;
+
+  // Small files are kept inline, larger ones are moved to data blocks
+  if (inode->flags & INODE_FLAG_INLINE) {
+    if (offset + nbytes <= INLINE_DATA_SIZE) {
+      memcpy(inode->inline_data + offset, buf, nbytes);
+      if (inode->file_size < offset + nbytes)
+        inode->file_size = offset + nbytes;
+      simplefs_writeInode(inodenum, inode);
+      return 0;
+    }
+    if (simplefs_promoteInline(inodenum, inode) == -1)
+      return -1;
   }
 
-  int first_new = MAX_FILE_SIZE;
-  // Start allocating new blocks
-  for (int i = 0; i < req_blocks; i++) {
-    // Ignore blocks which are already allocated
-    if (inode->direct_blocks[i] != -1)
-      continue;
+  // Compressed files go through the chunk layer
+  if (DISK_FEATURES & FEATURE_COMPRESSION)
+    return simplefs_writeCompressed(inodenum, inode, offset, buf, nbytes);
+
+  // Reserve the blocks the write takes before allocating any, so a full disk
+  // fails it right away. Holes take a block each, and so do shared blocks,
+  // whose old copy stays with the other users. Log-structured disks also
+  // move the rest of the blocks written to, each freeing its old copy right
+  // after, which takes one spare block
+  int needed = 0, moves = 0;
+  for (int i = offset / BLOCKSIZE; i < req_blocks; i++) {
+    int blocknum = inode->direct_blocks[i];
+    if (blocknum == -1 ||
+        (DISK_SHARING && simplefs_dataBlockRefs(blocknum) > 1))
+      needed++;
+    else if (DISK_FEATURES & FEATURE_LOG)
+      moves = 1;
+  }
+  if (simplefs_reserveDataBlocks(needed + moves) == -1)
+    return -1;
 
-    // Save the index of first block which needs to be allocated
-    if (first_new == MAX_FILE_SIZE)
-      first_new = i;
+  int is_new[MAX_FILE_SIZE] = {0};
+  // Allocate the blocks written to, blocks before `offset` stay holes
+  for (int i = offset / BLOCKSIZE; i < req_blocks; i++) {
+    // Allocate the block if it is feasible, right after the previous one
+    int goal = 0;
+    for (int j = i - 1; j >= 0 && goal == 0; j--)
+      if (inode->direct_blocks[j] != -1)
+        goal = inode->direct_blocks[j] + 1;
+
+    // Blocks already allocated only need their own copy if shared, keeping
+    // the old contents unless the block is overwritten whole
+    if (inode->direct_blocks[i] != -1) {
+      int whole = offset <= i * BLOCKSIZE &&
+                  offset + nbytes >= (i + 1) * BLOCKSIZE;
+      int blocknum = simplefs_unshareDataBlock(
+          inodenum, inode->direct_blocks[i], goal, !whole);
+      if (blocknum == -1) {
+        // Blocks copied so far are kept, the inode has to point at them
+        simplefs_writeInode(inodenum, inode);
+        simplefs_unreserveDataBlocks();
+        return -1;
+      }
+      inode->direct_blocks[i] = blocknum;
+      continue;
+    }
 
-    // Allocate the block if it is feasible
-    inode->direct_blocks[i] = simplefs_allocDataBlock();
+    inode->direct_blocks[i] = simplefs_allocDataBlockNear(inodenum, goal);
+    is_new[i] = 1;
 
     // Continue if the allocation succeeds
     if (inode->direct_blocks[i] != -1)
       continue;
 
     // If the allocation fails then revert back thing
-    for (i--; i >= first_new; i--) {
-      simplefs_freeDataBlock(inode->direct_blocks[i]);
+    for (; i >= 0; i--) {
+      if (!is_new[i])
+        continue;
+      if (inode->direct_blocks[i] != -1)
+        simplefs_freeDataBlock(inode->direct_blocks[i]);
       inode->direct_blocks[i] = -1;
     }
-    free(inode); // Free malloced data
+    simplefs_writeInode(inodenum, inode);
+    simplefs_unreserveDataBlocks();
     return -1;
   }
 
@@ -254,52 +482,38 @@ int simplefs_write(int file_handle, char *buf, int nbytes) {
 
   // Write the inode
   simplefs_writeInode(inodenum, inode);
+  simplefs_unreserveDataBlocks();
 
   char tempBlockBuf[BLOCKSIZE];
   int tempset = 0;
-  // Iterate over all possible data blocks
-  for (int i = 0; i < MAX_FILE_SIZE; i++) {
-    // If found an allocated block, break loop
-    if (inode->direct_blocks[i] == -1)
-      break;
-
-    // If end is before the block, break loop
-    if (offset + nbytes <= i * BLOCKSIZE)
-      break;
-
-    // Set is_new
-    int is_new = 0;
-    if (first_new <= i)
-      is_new = 1;
-
-    // If we don't need this block then skip
-    if (offset + tempset > (i + 1) * BLOCKSIZE)
-      continue;
-
-    // Read the data block, if not new
-    if (!is_new) {
-      simplefs_readDataBlock(inode->direct_blocks[i], tempBlockBuf);
-    }
-
-    // Set ls as left side diff and rs as right side diff
-    int ls = offset - (i * BLOCKSIZE);
-    int rs = (i + 1) * BLOCKSIZE - (offset + nbytes);
-    if (ls < 0)
-      ls = 0;
-    if (rs < 0)
-      rs = 0;
+  // Iterate over the data blocks covering the range
+  for (int i = offset / BLOCKSIZE; tempset < nbytes; i++) {
+    // Set ls as left side diff and len as the bytes written to this block
+    int ls = offset + tempset - i * BLOCKSIZE;
+    int len = BLOCKSIZE - ls;
+    if (len > nbytes - tempset)
+      len = nbytes - tempset;
+
+    // Read the data block, if not new and only partly overwritten. A block
+    // failing its checksum is left alone rather than written back with the
+    // bad data checksummed
+    if (is_new[i])
+      memset(tempBlockBuf, 0, BLOCKSIZE);
+    else if (len < BLOCKSIZE &&
+             simplefs_readDataBlock(inode->direct_blocks[i], tempBlockBuf) ==
+                 -1)
+      return -1;
 
     // Update the required portion of the data block
-    memcpy(tempBlockBuf + ls, buf + tempset, BLOCKSIZE - ls - rs);
+    memcpy(tempBlockBuf + ls, buf + tempset, len);
 
     // Write the data block
     simplefs_writeDataBlock(inode->direct_blocks[i], tempBlockBuf);
 
     // Update the tempset
-    tempset += BLOCKSIZE - ls - rs;
+    tempset += len;
   }
 
-  free(inode); // Free malloced data
   return 0;
 }
 
@@ -316,22 +530,424 @@ int simplefs_seek(int file_handle, int nseek) {
   if (new_offset < 0)
     return -1;
 
-  // Get the inode number
-  int inodenum = file_handle_array[file_handle].inode_number;
+  // Offsets past the end of file are allowed up to the largest file size,
+  // a later write there leaves a hole
+  if (new_offset > MAX_FILE_SIZE * BLOCKSIZE)
+    return -1;
+
+  // Update the offset in file handle
+  file_handle_array[file_handle].offset = new_offset;
+
+  return 0;
+}
+
+// Cut or extend inode `inodenum` to `size` bytes, see simplefs_truncate
+static int simplefs_truncateInode(int inodenum, int size) {
   struct inode_t *inode = (struct inode_t *)malloc(sizeof(struct inode_t));
 
-  // Read the inode
-  simplefs_readInode(inodenum, inode);
+  // Read the inode. Mappings of blocks about to be freed become private
+  if (simplefs_readInode(inodenum, inode) == -1 ||
+      (size < inode->file_size &&
+       simplefs_privatizeMappings(inodenum) == -1)) {
+    free(inode); // Free malloced data
+    return -1;
+  }
+
+  // Inline files only need the inode rewritten, unless they outgrow it
+  if (inode->flags & INODE_FLAG_INLINE) {
+    if (size <= INLINE_DATA_SIZE) {
+      memset(inode->inline_data + size, 0, INLINE_DATA_SIZE - size);
+      inode->file_size = size;
+      simplefs_writeInode(inodenum, inode);
+      free(inode); // Free malloced data
+      return 0;
+    }
+    if (simplefs_promoteInline(inodenum, inode) == -1) {
+      free(inode); // Free malloced data
+      return -1;
+    }
+  }
+
+  // Compressed files go through the chunk layer
+  if (DISK_FEATURES & FEATURE_COMPRESSION) {
+    int ret = simplefs_truncateCompressed(inodenum, inode, size);
+    free(inode); // Free malloced data
+    return ret;
+  }
+
+  // Zero the tail of the last kept block so growing again reads zeros
+  int keep = (size + BLOCKSIZE - 1) / BLOCKSIZE;
+  if (size < inode->file_size && size % BLOCKSIZE &&
+      inode->direct_blocks[keep - 1] != -1) {
+    // The old tail is read first, a block failing its checksum leaves the
+    // file as it is. A shared block is copied, snapshots keep the old tail
+    char tempBlockBuf[BLOCKSIZE];
+    if (simplefs_readDataBlock(inode->direct_blocks[keep - 1], tempBlockBuf) ==
+        -1) {
+      free(inode); // Free malloced data
+      return -1;
+    }
+    int blocknum = simplefs_unshareDataBlock(
+        inodenum, inode->direct_blocks[keep - 1],
+        inode->direct_blocks[keep - 1], 0);
+    if (blocknum == -1) {
+      free(inode); // Free malloced data
+      return -1;
+    }
+    inode->direct_blocks[keep - 1] = blocknum;
+    memset(tempBlockBuf + size % BLOCKSIZE, 0, BLOCKSIZE - size % BLOCKSIZE);
+    simplefs_writeDataBlock(inode->direct_blocks[keep - 1], tempBlockBuf);
+  }
+
+  // Free every block past the new end in one go
+  int blocknums[MAX_FILE_SIZE];
+  int count = 0;
+  for (int i = keep; i < MAX_FILE_SIZE; i++) {
+    if (inode->direct_blocks[i] == -1)
+      continue;
+    blocknums[count++] = inode->direct_blocks[i];
+    inode->direct_blocks[i] = -1;
+  }
+  simplefs_freeDataBlocks(blocknums, count);
+
+  // Update the file size and write the inode
+  inode->file_size = size;
+  simplefs_writeInode(inodenum, inode);
+
+  free(inode); // Free malloced data
+  return 0;
+}
+
+// Cut or extend the file pointed by `file_handle` to `size` bytes. Blocks past
+// the new end, including reserved ones, are freed in one free-map update
+int simplefs_truncate(int file_handle, int size) {
+  // Check if the file handle and size are feasible
+  if (file_handle >= MAX_OPEN_FILES)
+    return -1;
+  if (size < 0 || size > MAX_FILE_SIZE * BLOCKSIZE)
+    return -1;
+  if (file_handle_array[file_handle].snapshot != -1)
+    return -1;
+
+  // The inode is held from being read to being written back, so defrag
+  // can't move its blocks in between
+  simplefs_lockMetadata();
+  int ret = simplefs_truncateInode(file_handle_array[file_handle].inode_number,
+                                   size);
+  simplefs_unlockMetadata();
+  return ret;
+}
+
+// Reserve data blocks for `len` bytes at `offset` of inode `inodenum`, see
+// simplefs_fallocate
+static int simplefs_fallocateInode(int inodenum, int offset, int len) {
+  struct inode_t *inode = (struct inode_t *)malloc(sizeof(struct inode_t));
 
-  // If new offset crosses file size, do nothing
-  if (new_offset > inode->file_size) {
+  // Read the inode, moving inline data out to blocks
+  if (simplefs_readInode(inodenum, inode) == -1 ||
+      ((inode->flags & INODE_FLAG_INLINE) &&
+       simplefs_promoteInline(inodenum, inode) == -1)) {
     free(inode); // Free malloced data
     return -1;
   }
 
-  // Update the offset in file handle
-  file_handle_array[file_handle].offset = new_offset;
+  // Find the blocks of the range not allocated yet
+  int missing[MAX_FILE_SIZE];
+  int count = 0;
+  for (int i = offset / BLOCKSIZE; i <= (offset + len - 1) / BLOCKSIZE; i++)
+    if (inode->direct_blocks[i] == -1)
+      missing[count++] = i;
+
+  // Allocate them all at once
+  int blocknums[MAX_FILE_SIZE];
+  if (count == 0 || simplefs_allocDataBlocks(count, blocknums) == -1) {
+    free(inode); // Free malloced data
+    return count == 0 ? 0 : -1;
+  }
+
+  // Zero them, one write per contiguous run
+  char zeros[MAX_FILE_SIZE * BLOCKSIZE];
+  memset(zeros, 0, sizeof(zeros));
+  for (int i = 0, run; i < count; i += run) {
+    for (run = 1; i + run < count; run++)
+      if (blocknums[i + run] != blocknums[i] + run)
+        break;
+    simplefs_writeDataBlocks(blocknums[i], run, zeros);
+  }
+
+  // Attach them to the file and write the inode
+  for (int i = 0; i < count; i++)
+    inode->direct_blocks[missing[i]] = blocknums[i];
+  simplefs_writeInode(inodenum, inode);
 
   free(inode); // Free malloced data
   return 0;
 }
+
+// Reserve data blocks for `len` bytes at `offset` of the file pointed by
+// `file_handle`, contiguous where possible, without changing its size. Later
+// writes into the range need no allocation
+int simplefs_fallocate(int file_handle, int offset, int len) {
+  // Check if the file handle and range are feasible
+  if (file_handle >= MAX_OPEN_FILES)
+    return -1;
+  if (offset < 0 || len <= 0 || offset + len > MAX_FILE_SIZE * BLOCKSIZE)
+    return -1;
+  if (file_handle_array[file_handle].snapshot != -1)
+    return -1;
+
+  // Packed compressed blocks can't be reserved ahead of time
+  if (DISK_FEATURES & FEATURE_COMPRESSION)
+    return -1;
+
+  // The inode is held from being read to being written back, so defrag
+  // can't move its blocks in between
+  simplefs_lockMetadata();
+  int ret = simplefs_fallocateInode(file_handle_array[file_handle].inode_number,
+                                    offset, len);
+  simplefs_unlockMetadata();
+  return ret;
+}
+
+// Point blocks [dfirst, dfirst + count) of inode `dstnum`, already read into
+// `dst`, at the data of blocks [sfirst, sfirst + count) of `src`. The blocks
+// are shared, or copied block to block if one has all the users it can take.
+// Holes stay holes, the blocks the range held before are given back. Returns
+// -1 if the disk is full or a block fails its checksum
+static int simplefs_copyBlocks(struct inode_t *src, int sfirst, int dstnum,
+                               struct inode_t *dst, int dfirst, int count) {
+  int blocknums[MAX_FILE_SIZE];
+  int present = 0;
+  for (int i = 0; i < count; i++)
+    if (src->direct_blocks[sfirst + i] != -1)
+      blocknums[present++] = src->direct_blocks[sfirst + i];
+
+  // Copy the blocks into new ones if they can't take another user, one read
+  // and one write per contiguous run. They are all read before any is
+  // allocated, so a block failing its checksum leaves both files alone
+  if (simplefs_shareDataBlocks(blocknums, present) == -1) {
+    char tempBuf[MAX_FILE_SIZE * BLOCKSIZE];
+    for (int i = 0, run; i < present; i += run) {
+      for (run = 1; i + run < present; run++)
+        if (blocknums[i + run] != blocknums[i] + run)
+          break;
+      if (simplefs_readDataBlocks(blocknums[i], run,
+                                  tempBuf + i * BLOCKSIZE) == -1)
+        return -1;
+    }
+    if (simplefs_allocDataBlocks(present, blocknums) == -1)
+      return -1;
+    for (int i = 0, run; i < present; i += run) {
+      for (run = 1; i + run < present; run++)
+        if (blocknums[i + run] != blocknums[i] + run)
+          break;
+      simplefs_writeDataBlocks(blocknums[i], run, tempBuf + i * BLOCKSIZE);
+    }
+  }
+
+  // Swap the blocks in, then give back the old ones
+  int old[MAX_FILE_SIZE];
+  int nold = 0;
+  for (int i = 0, n = 0; i < count; i++) {
+    if (dst->direct_blocks[dfirst + i] != -1)
+      old[nold++] = dst->direct_blocks[dfirst + i];
+    dst->direct_blocks[dfirst + i] =
+        src->direct_blocks[sfirst + i] == -1 ? -1 : blocknums[n++];
+  }
+  if (dst->file_size < (dfirst + count) * BLOCKSIZE)
+    dst->file_size = (dfirst + count) * BLOCKSIZE;
+  simplefs_writeInode(dstnum, dst);
+  simplefs_freeDataBlocks(old, nold);
+  return 0;
+}
+
+// copy `len` bytes of the file pointed by `src_handle` starting at
+// `src_off` to the file pointed by `dst_handle` at `dst_off`. Whole blocks at
+// the same place within a block in both files are handed over inside the
+// disk layer, sharing or copying them block to block. Bytes before and after
+// them go through a buffer, and so does everything in compressed files,
+// from inline files or within one file
+int simplefs_copy_file_range(int src_handle, int src_off, int dst_handle,
+                             int dst_off, int len) {
+  // Check if the file handles and ranges are feasible
+  if (src_handle >= MAX_OPEN_FILES || dst_handle >= MAX_OPEN_FILES)
+    return -1;
+  if (src_off < 0 || dst_off < 0 || len <= 0 ||
+      dst_off + len > MAX_FILE_SIZE * BLOCKSIZE)
+    return -1;
+  if (file_handle_array[dst_handle].snapshot != -1)
+    return -1;
+
+  // Read both inodes, the range has to lie inside the source
+  int srcnum = file_handle_array[src_handle].inode_number;
+  int dstnum = file_handle_array[dst_handle].inode_number;
+  struct inode_t *src = (struct inode_t *)malloc(sizeof(struct inode_t));
+  struct inode_t *dst = (struct inode_t *)malloc(sizeof(struct inode_t));
+  simplefs_lockMetadata();
+  simplefs_readHandleInode(src_handle, src);
+  if (simplefs_readInode(dstnum, dst) == -1 ||
+      src_off + len > src->file_size) {
+    simplefs_unlockMetadata();
+    free(dst);
+    free(src); // Free malloced data
+    return -1;
+  }
+
+  // Split the range into a head up to a block boundary of the destination,
+  // whole blocks and a tail. Blocks only move whole if the source lines up
+  int head = (BLOCKSIZE - dst_off % BLOCKSIZE) % BLOCKSIZE;
+  if (head > len)
+    head = len;
+  int count = (len - head) / BLOCKSIZE;
+  if ((DISK_FEATURES & FEATURE_COMPRESSION) ||
+      (src->flags & INODE_FLAG_INLINE) ||
+      (srcnum == dstnum && file_handle_array[src_handle].snapshot == -1) ||
+      src_off % BLOCKSIZE != dst_off % BLOCKSIZE)
+    count = 0;
+  int tail = len - head - count * BLOCKSIZE;
+
+  // Move inline data of the destination out to blocks first. Mappings of
+  // blocks about to be shared or freed become private
+  if (count > 0 && (simplefs_privatizeMappings(srcnum) == -1 ||
+                    simplefs_privatizeMappings(dstnum) == -1 ||
+                    ((dst->flags & INODE_FLAG_INLINE) &&
+                     simplefs_promoteInline(dstnum, dst) == -1))) {
+    simplefs_unlockMetadata();
+    free(dst);
+    free(src); // Free malloced data
+    return -1;
+  }
+
+  // Buffered copy of the range if no block moves whole, else of the head
+  char tempBuf[MAX_FILE_SIZE * BLOCKSIZE];
+  int ret = 0;
+  int nbytes = count == 0 ? len : head;
+  if (nbytes > 0) {
+    ret = simplefs_readFile(srcnum, src, src_off, tempBuf, nbytes);
+    if (ret == 0)
+      ret = simplefs_writeFile(dstnum, dst, dst_off, tempBuf, nbytes);
+  }
+
+  // Whole blocks, then the tail through the buffer
+  if (ret == 0 && count > 0) {
+    ret = simplefs_copyBlocks(src, (src_off + head) / BLOCKSIZE, dstnum, dst,
+                              (dst_off + head) / BLOCKSIZE, count);
+    int tailset = len - tail;
+    if (ret == 0 && tail > 0)
+      ret = simplefs_readFile(srcnum, src, src_off + tailset, tempBuf, tail);
+    if (ret == 0 && tail > 0)
+      ret = simplefs_writeFile(dstnum, dst, dst_off + tailset, tempBuf, tail);
+  }
+  simplefs_unlockMetadata();
+
+  free(dst);
+  free(src); // Free malloced data
+  return ret;
+}
+
+// Whether block `i` of `inode` holds data rather than a hole. `chunks` is the
+// chunk map on compressed disks
+static int simplefs_blockHasData(struct inode_t *inode, struct chunk_t *chunks,
+                                 int i) {
+  if (inode->flags & INODE_FLAG_INLINE)
+    return 1;
+  if (DISK_FEATURES & FEATURE_COMPRESSION)
+    return chunks[i].length != 0;
+  return inode->direct_blocks[i] != -1;
+}
+
+// Move `file_handle` offset to the start of data at or after it, skipping
+// holes. Returns the new offset, -1 if only holes follow
+int simplefs_seek_data(int file_handle) {
+  // Check if the file handle is feasible
+  if (file_handle >= MAX_OPEN_FILES)
+    return -1;
+
+  // Get the offset and read the inode and chunk map
+  int offset = file_handle_array[file_handle].offset;
+  int inodenum = file_handle_array[file_handle].inode_number;
+  struct inode_t inode;
+  struct chunk_t chunks[MAX_FILE_SIZE];
+  simplefs_readHandleInode(file_handle, &inode);
+  if (DISK_FEATURES & FEATURE_COMPRESSION)
+    simplefs_readChunkMap(inodenum, chunks);
+
+  // Find the first block with data
+  for (int i = offset / BLOCKSIZE; i * BLOCKSIZE < inode.file_size; i++) {
+    if (!simplefs_blockHasData(&inode, chunks, i))
+      continue;
+    if (offset < i * BLOCKSIZE)
+      offset = i * BLOCKSIZE;
+    file_handle_array[file_handle].offset = offset;
+    return offset;
+  }
+  return -1;
+}
+
+// Move `file_handle` offset to the start of the hole at or after it. The end
+// of file counts as a hole. Returns the new offset, -1 if past end of file
+int simplefs_seek_hole(int file_handle) {
+  // Check if the file handle is feasible
+  if (file_handle >= MAX_OPEN_FILES)
+    return -1;
+
+  // Get the offset and read the inode and chunk map
+  int offset = file_handle_array[file_handle].offset;
+  int inodenum = file_handle_array[file_handle].inode_number;
+  struct inode_t inode;
+  struct chunk_t chunks[MAX_FILE_SIZE];
+  simplefs_readHandleInode(file_handle, &inode);
+  if (DISK_FEATURES & FEATURE_COMPRESSION)
+    simplefs_readChunkMap(inodenum, chunks);
+  if (offset >= inode.file_size)
+    return -1;
+
+  // Find the first hole block, or stop at the end of file
+  int i = offset / BLOCKSIZE;
+  while (i * BLOCKSIZE < inode.file_size &&
+         simplefs_blockHasData(&inode, chunks, i))
+    i++;
+  if (offset < i * BLOCKSIZE)
+    offset = i * BLOCKSIZE;
+  if (offset > inode.file_size)
+    offset = inode.file_size;
+  file_handle_array[file_handle].offset = offset;
+  return offset;
+}
+
+// Fill `st` with what inode `inodenum`, read into `inode`, records
+static void simplefs_fillStat(int inodenum, struct inode_t *inode,
+                              struct stat_t *st) {
+  st->inode_number = inodenum;
+  st->size = inode->file_size;
+  st->flags = inode->flags;
+  st->blocks = 0;
+  for (int i = 0; i < MAX_FILE_SIZE; i++)
+    if (inode->direct_blocks[i] != -1)
+      st->blocks++;
+}
+
+// Fill `st` with the size, blocks and flags of the file or directory with
+// name or path `filename`, from its inode without reading any data block.
+// Returns -1 if there is none
+int simplefs_stat(char *filename, struct stat_t *st) {
+  int inodenum = simplefs_lookupPath(filename);
+  if (inodenum == -1)
+    return -1;
+  struct inode_t inode;
+  simplefs_readInode(inodenum, &inode);
+  simplefs_fillStat(inodenum, &inode, st);
+  return 0;
+}
+
+// Fill `st` as simplefs_stat does for the file behind `file_handle`, as its
+// snapshot has it if it has one. Returns -1 if the handle isn't open
+int simplefs_fstat(int file_handle, struct stat_t *st) {
+  if (file_handle < 0 || file_handle >= MAX_OPEN_FILES ||
+      file_handle_array[file_handle].inode_number == -1)
+    return -1;
+  struct inode_t inode;
+  simplefs_readHandleInode(file_handle, &inode);
+  simplefs_fillStat(file_handle_array[file_handle].inode_number, &inode, st);
+  return 0;
+}
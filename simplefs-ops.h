@@ -1,14 +1,34 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-
-#include "simplefs-disk.h"
-
-// Functions to implement in simplefs-ops.c
-int simplefs_create(char *filename);
-int simplefs_open(char *filename);
-void simplefs_delete(char *filename);
-void simplefs_close(int file_handle);
-int simplefs_read(int file_handle, char *buf, int nbytes);
-int simplefs_write(int file_handle, char *buf, int nbytes);
-int simplefs_seek(int file_handle, int nseek);
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+
+#include "simplefs-disk.h"
+
+// Functions to implement in simplefs-ops.c
+int simplefs_create(char *filename);
+int simplefs_open(char *filename);
+int simplefs_open_append(char *filename);
+void simplefs_delete(char *filename);
+void simplefs_close(int file_handle);
+int simplefs_read(int file_handle, char *buf, int nbytes);
+int simplefs_write(int file_handle, char *buf, int nbytes);
+int simplefs_pread(int file_handle, char *buf, int nbytes, int offset);
+int simplefs_pwrite(int file_handle, char *buf, int nbytes, int offset);
+int simplefs_readv(int file_handle, const struct iovec *iov, int iovcnt);
+int simplefs_writev(int file_handle, const struct iovec *iov, int iovcnt);
+int simplefs_seek(int file_handle, int nseek);
+int simplefs_seek_data(int file_handle);
+int simplefs_seek_hole(int file_handle);
+int simplefs_truncate(int file_handle, int size);
+int simplefs_fallocate(int file_handle, int offset, int len);
+int simplefs_copy_file_range(int src_handle, int src_off, int dst_handle,
+                             int dst_off, int len);
+int simplefs_stat(char *filename, struct stat_t *st);
+int simplefs_fstat(int file_handle, struct stat_t *st);
+
+// Helpers working on an inode already read from disk
+int simplefs_readFile(int inodenum, struct inode_t *inode, int offset,
+                      char *buf, int nbytes);
+int simplefs_writeFile(int inodenum, struct inode_t *inode, int offset,
+                       char *buf, int nbytes);
@@ -0,0 +1,80 @@
+#include "simplefs-reclaim.h"
+
+#include <pthread.h>
+
+// Reclaimer thread and the deletes waiting for it
+static pthread_t reclaimer;
+static pthread_mutex_t reclaim_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t reclaim_cond = PTHREAD_COND_INITIALIZER;
+static int reclaimer_running;
+static int reclaim_pending;
+
+// Wait for deletes, give more of them a moment to pile up, then free them
+// all with one call
+static void *simplefs_reclaimerThread(void *arg) {
+  (void)arg;
+  pthread_mutex_lock(&reclaim_lock);
+  while (reclaimer_running) {
+    if (!reclaim_pending) {
+      pthread_cond_wait(&reclaim_cond, &reclaim_lock);
+      continue;
+    }
+    pthread_mutex_unlock(&reclaim_lock);
+    usleep(RECLAIM_DELAY_US);
+    pthread_mutex_lock(&reclaim_lock);
+    reclaim_pending = 0;
+    pthread_mutex_unlock(&reclaim_lock);
+    simplefs_reclaim();
+    pthread_mutex_lock(&reclaim_lock);
+  }
+  pthread_mutex_unlock(&reclaim_lock);
+  return NULL;
+}
+
+// Start freeing deleted files in the background. Until
+// simplefs_stopReclaimer, simplefs_delete only marks the inode as an orphan,
+// and allocations that run out of space reclaim right away. Returns -1 if
+// it is already running or the thread can't be started
+int simplefs_startReclaimer() {
+  pthread_mutex_lock(&reclaim_lock);
+  if (reclaimer_running) {
+    pthread_mutex_unlock(&reclaim_lock);
+    return -1;
+  }
+  reclaimer_running = 1;
+  reclaim_pending = 0;
+  if (pthread_create(&reclaimer, NULL, simplefs_reclaimerThread, NULL)) {
+    reclaimer_running = 0;
+    pthread_mutex_unlock(&reclaim_lock);
+    return -1;
+  }
+  pthread_mutex_unlock(&reclaim_lock);
+  return 0;
+}
+
+// Stop the reclaimer and free what it left, deletes are synchronous again
+void simplefs_stopReclaimer() {
+  pthread_mutex_lock(&reclaim_lock);
+  if (!reclaimer_running) {
+    pthread_mutex_unlock(&reclaim_lock);
+    return;
+  }
+  reclaimer_running = 0;
+  pthread_cond_signal(&reclaim_cond);
+  pthread_mutex_unlock(&reclaim_lock);
+  pthread_join(reclaimer, NULL);
+  simplefs_reclaim();
+}
+
+// Hand the orphans to the reclaimer. Returns 0 if it isn't running, for the
+// caller to reclaim them itself
+int simplefs_queueReclaim() {
+  pthread_mutex_lock(&reclaim_lock);
+  int queued = reclaimer_running;
+  if (queued) {
+    reclaim_pending = 1;
+    pthread_cond_signal(&reclaim_cond);
+  }
+  pthread_mutex_unlock(&reclaim_lock);
+  return queued;
+}
@@ -0,0 +1,15 @@
+// BACKGROUND RECLAMATION
+#ifndef SIMPLEFS_RECLAIM_H
+#define SIMPLEFS_RECLAIM_H
+
+#include "simplefs-disk.h"
+
+#define RECLAIM_DELAY_US 1000 // Time deletes are gathered before freeing
+
+int simplefs_startReclaimer();
+void simplefs_stopReclaimer();
+
+// Helper for simplefs_delete
+int simplefs_queueReclaim();
+
+#endif
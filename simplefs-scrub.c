@@ -0,0 +1,132 @@
+#include "simplefs-scrub.h"
+
+#include <pthread.h>
+#include <time.h>
+
+// FEATURE_* flags the disk was formatted with
+extern int DISK_FEATURES;
+
+// Scrubber thread, its pace and what it found
+static pthread_t scrubber;
+static pthread_mutex_t scrub_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t scrub_cond = PTHREAD_COND_INITIALIZER;
+static int scrubber_running;
+static int scrub_interval_us; // pause after each block checked
+static struct scrub_report_t scrub_report = {.last_bad = -1};
+
+// Check data block `blocknum` against its checksum if it is in use. Returns
+// 1 if it fails, 0 if it passes, -1 if it is free
+static int simplefs_scrubBlock(int blocknum) {
+  simplefs_lockMetadata();
+  int ret = -1;
+  if (simplefs_dataBlockRefs(blocknum) > 0)
+    ret = simplefs_verifyDataBlock(blocknum) == -1;
+  simplefs_unlockMetadata();
+  return ret;
+}
+
+// Check every data block in use against its checksum, reading it from the
+// disk rather than from any cache. Returns the number failing, -1 if the
+// disk keeps no checksums
+int simplefs_scrub() {
+  if (!(DISK_FEATURES & FEATURE_CHECKSUM))
+    return -1;
+  int bad = 0;
+  for (int i = 0; i < NUM_DATA_BLOCKS; i++)
+    bad += simplefs_scrubBlock(i) == 1;
+  return bad;
+}
+
+// Wait out the pause between two blocks, or until the scrubber is stopped.
+// The caller holds the scrub lock
+static void simplefs_scrubPause() {
+  struct timespec until;
+  clock_gettime(CLOCK_REALTIME, &until);
+  long nsec = until.tv_nsec + scrub_interval_us * 1000L;
+  until.tv_sec += nsec / 1000000000L;
+  until.tv_nsec = nsec % 1000000000L;
+  while (scrubber_running &&
+         pthread_cond_timedwait(&scrub_cond, &scrub_lock, &until) == 0)
+    ;
+}
+
+// Go over the data blocks again and again, one at a time, pausing after each
+// one in use, and after a pass that found none, so the scrubber keeps to its
+// pace
+static void *simplefs_scrubberThread(void *arg) {
+  (void)arg;
+  pthread_mutex_lock(&scrub_lock);
+  while (scrubber_running) {
+    int bad = 0, checked = 0;
+    int i = 0;
+    for (; i < NUM_DATA_BLOCKS && scrubber_running; i++) {
+      pthread_mutex_unlock(&scrub_lock);
+      int ret = simplefs_scrubBlock(i);
+      pthread_mutex_lock(&scrub_lock);
+      if (ret == -1)
+        continue;
+      if (ret == 1) {
+        bad++;
+        scrub_report.last_bad = i;
+      }
+      checked++;
+      simplefs_scrubPause();
+    }
+    if (i < NUM_DATA_BLOCKS)
+      break;
+    scrub_report.passes++;
+    scrub_report.bad_blocks = bad;
+    if (checked == 0)
+      simplefs_scrubPause();
+  }
+  pthread_mutex_unlock(&scrub_lock);
+  return NULL;
+}
+
+// Start checking the data blocks in use against their checksums in the
+// background, at most `blocks_per_second` of them a second, until
+// simplefs_stopScrubber. Blocks are read from the disk, so damage to blocks
+// nobody reads is found too, and reported by simplefs_scrubReport. Returns
+// -1 if it is already running, the disk keeps no checksums, the pace isn't
+// positive or the thread can't be started
+int simplefs_startScrubber(int blocks_per_second) {
+  if (!(DISK_FEATURES & FEATURE_CHECKSUM) || blocks_per_second < 1)
+    return -1;
+  pthread_mutex_lock(&scrub_lock);
+  if (scrubber_running) {
+    pthread_mutex_unlock(&scrub_lock);
+    return -1;
+  }
+  scrubber_running = 1;
+  scrub_interval_us = 1000000 / blocks_per_second;
+  scrub_report.passes = 0;
+  scrub_report.bad_blocks = 0;
+  scrub_report.last_bad = -1;
+  if (pthread_create(&scrubber, NULL, simplefs_scrubberThread, NULL)) {
+    scrubber_running = 0;
+    pthread_mutex_unlock(&scrub_lock);
+    return -1;
+  }
+  pthread_mutex_unlock(&scrub_lock);
+  return 0;
+}
+
+// Stop the scrubber, its report is kept
+void simplefs_stopScrubber() {
+  pthread_mutex_lock(&scrub_lock);
+  if (!scrubber_running) {
+    pthread_mutex_unlock(&scrub_lock);
+    return;
+  }
+  scrubber_running = 0;
+  pthread_cond_signal(&scrub_cond);
+  pthread_mutex_unlock(&scrub_lock);
+  pthread_join(scrubber, NULL);
+}
+
+// Fill `report` with what the scrubber found since it was last started
+void simplefs_scrubReport(struct scrub_report_t *report) {
+  pthread_mutex_lock(&scrub_lock);
+  *report = scrub_report;
+  pthread_mutex_unlock(&scrub_lock);
+}
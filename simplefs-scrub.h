@@ -0,0 +1,19 @@
+// BACKGROUND SCRUBBING
+#ifndef SIMPLEFS_SCRUB_H
+#define SIMPLEFS_SCRUB_H
+
+#include "simplefs-disk.h"
+
+// What the scrubber found so far
+struct scrub_report_t {
+  int passes;     // passes over the data blocks in use completed
+  int bad_blocks; // blocks failing their checksum in the last pass
+  int last_bad;   // last block found failing its checksum, -1 if none
+};
+
+int simplefs_scrub();
+int simplefs_startScrubber(int blocks_per_second);
+void simplefs_stopScrubber();
+void simplefs_scrubReport(struct scrub_report_t *report);
+
+#endif
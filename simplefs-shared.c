@@ -0,0 +1,196 @@
+#include "simplefs-shared.h"
+#include "simplefs-checksum.h"
+#include "simplefs-compress.h"
+#include "simplefs-dir.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+
+#define METADATA_SIZE (DATA_BLOCK_START * BLOCKSIZE)
+
+// pointer to simplefs.txt
+extern int DISK_FD;
+
+// What the attached processes share. Every change is written to the disk as
+// well, so the disk always holds what the region does
+struct shared_region_t {
+  atomic_int ready;             // set once the creator has set up `lock`
+  pthread_mutex_t lock;         // metadata lock of every attached process
+  unsigned int generation;      // bumped by each write, so the other
+                                // processes drop their own caches
+  int metadata_loaded;          // 0 until `metadata` is read from disk
+  char metadata[METADATA_SIZE]; // superblock and inode blocks
+  struct inode_table_t inode_table;
+  char cached[NUM_DATA_BLOCKS]; // 1 if `blocks` holds the data block
+  char blocks[NUM_DATA_BLOCKS][BLOCKSIZE];
+};
+
+// Region this process is attached to, NULL if none
+static struct shared_region_t *region;
+// `generation` of the region when this process last dropped its caches
+static unsigned int seen_generation;
+
+// Drop the shared copies, they are read from disk again on next use, and
+// the caches of every process with them. The caller holds the shared lock
+static void simplefs_forgetShared() {
+  region->metadata_loaded = 0;
+  region->inode_table.loaded = 0;
+  memset(region->cached, 0, sizeof(region->cached));
+  region->generation++;
+}
+
+// Attach this process to the shared memory segment `name`, "/name" as for
+// shm_open, creating it if no process did yet. From then on the superblock,
+// the inode table and a cache of the data blocks are kept in the segment
+// behind one robust lock for all attached processes, so they work on the
+// disk together without reading the metadata again. Each process formats
+// or mounts the disk, or inherits it across fork, before attaching, with no
+// other thread using it. Writers of one file coordinate as threads do.
+// Returns -1 if already attached or the segment can't be set up
+int simplefs_attachShared(const char *name) {
+  if (region != NULL)
+    return -1;
+  int created = 1;
+  int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd == -1 && errno == EEXIST) {
+    created = 0;
+    fd = shm_open(name, O_RDWR, 0600);
+  }
+  if (fd == -1)
+    return -1;
+
+  // The creator sizes the segment, the others wait until it has
+  int ret;
+  if (created) {
+    ret = ftruncate(fd, sizeof(struct shared_region_t));
+  } else {
+    struct stat st;
+    while ((ret = fstat(fd, &st)) == 0 &&
+           st.st_size < (off_t)sizeof(struct shared_region_t))
+      sched_yield();
+  }
+  struct shared_region_t *shared =
+      ret == -1 ? MAP_FAILED
+                : mmap(NULL, sizeof(struct shared_region_t),
+                       PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (shared == MAP_FAILED) {
+    if (created)
+      shm_unlink(name);
+    return -1;
+  }
+
+  // A process dying with the lock held must not leave it taken for good
+  if (created) {
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&shared->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    atomic_store(&shared->ready, 1);
+  }
+  while (!atomic_load(&shared->ready))
+    sched_yield();
+
+  simplefs_shareMetadata(&shared->inode_table);
+  seen_generation = shared->generation;
+  region = shared;
+  return 0;
+}
+
+// Detach from the segment, the process goes on using the disk on its own.
+// Returns -1 if not attached
+int simplefs_detachShared() {
+  if (region == NULL)
+    return -1;
+  struct shared_region_t *shared = region;
+  region = NULL;
+  simplefs_shareMetadata(NULL);
+  munmap(shared, sizeof(struct shared_region_t));
+  return 0;
+}
+
+// Remove segment `name`, processes attached to it keep it until they
+// detach. Returns -1 if there is none
+int simplefs_unlinkShared(const char *name) { return shm_unlink(name); }
+
+// 1 if attached to a segment
+int simplefs_isShared() { return region != NULL; }
+
+// Take the lock of the attached processes, recursively. If its holder died
+// the shared copies may be half updated and are read from disk again. The
+// caches of this process are dropped if others wrote since it last looked.
+// Returns -1 if not attached
+int simplefs_lockShared() {
+  if (region == NULL)
+    return -1;
+  int ret = pthread_mutex_lock(&region->lock);
+  if (ret == EOWNERDEAD) {
+    simplefs_forgetShared();
+    pthread_mutex_consistent(&region->lock);
+  } else {
+    assert(ret == 0);
+  }
+  if (region->generation != seen_generation) {
+    simplefs_invalidateChunks(-1);
+    simplefs_invalidateDentries();
+    simplefs_invalidateChecksums();
+    seen_generation = region->generation;
+  }
+  return 0;
+}
+
+// Release the lock taken by simplefs_lockShared. Returns -1 if not attached
+int simplefs_unlockShared() {
+  if (region == NULL)
+    return -1;
+  pthread_mutex_unlock(&region->lock);
+  return 0;
+}
+
+// The shared copy of the superblock and inode blocks, read from disk on
+// first use. The caller holds the shared lock
+char *simplefs_sharedMetadata() {
+  if (!region->metadata_loaded) {
+    int ret = pread(DISK_FD, region->metadata, METADATA_SIZE, 0);
+    assert(ret != -1);
+
+    // A disk being formatted may not reach that far yet
+    memset(region->metadata + ret, 0, METADATA_SIZE - ret);
+    region->metadata_loaded = 1;
+  }
+  return region->metadata;
+}
+
+// The shared copy of `count` data blocks from `blocknum`, NULL unless all of
+// them are cached. The caller holds the shared lock
+char *simplefs_sharedBlocks(int blocknum, int count) {
+  for (int i = blocknum; i < blocknum + count; i++)
+    if (!region->cached[i])
+      return NULL;
+  return region->blocks[blocknum];
+}
+
+// Keep `count` data blocks from `blocknum`, just read from or written to
+// disk from `buf`, in the shared cache. The caller holds the shared lock
+void simplefs_cacheShared(int blocknum, int count, char *buf) {
+  memcpy(region->blocks[blocknum], buf, count * BLOCKSIZE);
+  memset(region->cached + blocknum, 1, count);
+}
+
+// Note a write by this process, the others drop their caches when they next
+// take the lock. The caller holds the shared lock
+void simplefs_touchShared() { seen_generation = ++region->generation; }
+
+// Drop the shared copies after the disk was changed behind them, if attached
+void simplefs_dropShared() {
+  if (simplefs_lockShared() == -1)
+    return;
+  simplefs_forgetShared();
+  simplefs_unlockShared();
+}
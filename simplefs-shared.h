@@ -0,0 +1,21 @@
+// SHARED ACCESS FROM SEVERAL PROCESSES
+#ifndef SIMPLEFS_SHARED_H
+#define SIMPLEFS_SHARED_H
+
+#include "simplefs-disk.h"
+
+int simplefs_attachShared(const char *name);
+int simplefs_detachShared();
+int simplefs_unlinkShared(const char *name);
+int simplefs_isShared();
+
+// Helpers for the disk layer
+int simplefs_lockShared();
+int simplefs_unlockShared();
+char *simplefs_sharedMetadata();
+char *simplefs_sharedBlocks(int blocknum, int count);
+void simplefs_cacheShared(int blocknum, int count, char *buf);
+void simplefs_touchShared();
+void simplefs_dropShared();
+
+#endif
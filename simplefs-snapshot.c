@@ -0,0 +1,222 @@
+#include "simplefs-snapshot.h"
+#include "simplefs-view.h"
+
+// Array for storing opened files
+extern struct filehandle_t file_handle_array[MAX_OPEN_FILES];
+// FEATURE_* flags the disk was formatted with
+extern int DISK_FEATURES;
+
+// Find the in-use inode named `filename`, either live (`snapshot` -1) or in
+// a snapshot. Returns its index, -1 if there is none
+static int simplefs_lookupInode(int snapshot, char *filename,
+                                struct inode_t *inode) {
+  if (snapshot == -1) {
+    int inodenum = simplefs_findInode(filename);
+    if (inodenum != -1)
+      simplefs_readInode(inodenum, inode);
+    return inodenum;
+  }
+  // Names fill all MAX_NAME_STRLEN bytes without a NUL when they are that
+  // long, and only files at the root are looked up, as simplefs_findInode
+  if (strlen(filename) > MAX_NAME_STRLEN)
+    return -1;
+  for (int inodenum = 0; inodenum < NUM_INODES; inodenum++) {
+    simplefs_readSnapshotInode(snapshot, inodenum, inode);
+    if (inode->status == INODE_IN_USE && !(inode->flags & INODE_FLAG_CHILD) &&
+        !strncmp(inode->name, filename, MAX_NAME_STRLEN))
+      return inodenum;
+  }
+  return -1;
+}
+
+// Create file `dst` sharing all data blocks of file `src`. Only metadata is
+// written, blocks are copied when either file writes to them. Returns the
+// new inode number, -1 if `src` is missing or a directory, `dst` is not a
+// valid name at the root or exists, or there is no room
+int simplefs_clone(char *src, char *dst) {
+  // Clones are files at the root, names have to fit the inode
+  if (dst[0] == '\0' || strchr(dst, '/') || strlen(dst) > MAX_NAME_STRLEN)
+    return -1;
+
+  struct inode_t *inode = (struct inode_t *)malloc(sizeof(struct inode_t));
+  struct inode_t *other = (struct inode_t *)malloc(sizeof(struct inode_t));
+
+  // Find the source and make sure the destination is new. Its mappings
+  // become private, writes through them would reach the clone
+  int srcnum = simplefs_lookupInode(-1, src, inode);
+  if (srcnum == -1 || (inode->flags & INODE_FLAG_DIR) ||
+      simplefs_lookupInode(-1, dst, other) != -1 ||
+      simplefs_privatizeMappings(srcnum) == -1) {
+    free(other);
+    free(inode); // Free malloced data
+    return -1;
+  }
+  free(other);
+
+  // Allocate inode if it is feasible
+  int dstnum = simplefs_allocInode();
+  if (dstnum == -1) {
+    free(inode); // Free malloced data
+    return -1;
+  }
+
+  // Add the clone as a user of every block
+  int blocknums[MAX_FILE_SIZE];
+  int count = 0;
+  for (int i = 0; i < MAX_FILE_SIZE; i++)
+    if (inode->direct_blocks[i] != -1)
+      blocknums[count++] = inode->direct_blocks[i];
+  if (simplefs_shareDataBlocks(blocknums, count) == -1) {
+    simplefs_freeInode(dstnum);
+    free(inode); // Free malloced data
+    return -1;
+  }
+
+  // Write the copied inode and chunk map
+  memset(inode->name, 0, MAX_NAME_STRLEN);
+  memcpy(inode->name, dst, strlen(dst));
+  simplefs_writeInode(dstnum, inode);
+  if (DISK_FEATURES & FEATURE_COMPRESSION) {
+    struct chunk_t chunks[MAX_FILE_SIZE];
+    simplefs_readChunkMap(srcnum, chunks);
+    simplefs_writeChunkMap(dstnum, chunks);
+  }
+
+  free(inode); // Free malloced data
+  return dstnum;
+}
+
+// Freeze the current inode table as a read-only snapshot. Data blocks gain
+// the snapshot as a user, so later writes copy them. Not available on
+// compressed or log-structured disks. Returns the snapshot id, -1 if all
+// slots are taken
+int simplefs_snapshot() {
+  if (DISK_FEATURES & (FEATURE_COMPRESSION | FEATURE_LOG))
+    return -1;
+
+  // Mapped files would write into the snapshot, their mappings become
+  // private
+  if (simplefs_privatizeMappings(-1) == -1)
+    return -1;
+
+  // Find a free snapshot slot
+  simplefs_lockMetadata();
+  struct superblock_t *superblock =
+      (struct superblock_t *)malloc(sizeof(struct superblock_t));
+  simplefs_readSuperBlock(superblock);
+  int snapshot;
+  for (snapshot = 0; snapshot < NUM_SNAPSHOTS; snapshot++)
+    if (superblock->snapshots[snapshot] == SNAPSHOT_FREE)
+      break;
+  if (snapshot == NUM_SNAPSHOTS) {
+    free(superblock);
+    simplefs_unlockMetadata();
+    return -1;
+  }
+
+  // Copy the inode table, collecting the blocks in use
+  struct inode_t *inode = (struct inode_t *)malloc(sizeof(struct inode_t));
+  int blocknums[NUM_INODES * MAX_FILE_SIZE];
+  int count = 0;
+  for (int i = 0; i < NUM_INODES; i++) {
+    simplefs_readInode(i, inode);
+    simplefs_writeSnapshotInode(snapshot, i, inode);
+    if (inode->status != INODE_IN_USE)
+      continue;
+    for (int j = 0; j < MAX_FILE_SIZE; j++)
+      if (inode->direct_blocks[j] != -1)
+        blocknums[count++] = inode->direct_blocks[j];
+  }
+  free(inode);
+
+  // Add the snapshot as a user of all of them, then mark the slot used
+  if (simplefs_shareDataBlocks(blocknums, count) == -1) {
+    free(superblock);
+    simplefs_unlockMetadata();
+    return -1;
+  }
+  simplefs_readSuperBlock(superblock);
+  superblock->snapshots[snapshot] = SNAPSHOT_IN_USE;
+  simplefs_writeSuperBlock(superblock);
+  free(superblock);
+  simplefs_unlockMetadata();
+  return snapshot;
+}
+
+// Delete snapshot `snapshot`, closing its handles and releasing the blocks
+// only it still uses
+int simplefs_snapshot_delete(int snapshot) {
+  struct superblock_t *superblock =
+      (struct superblock_t *)malloc(sizeof(struct superblock_t));
+  simplefs_readSuperBlock(superblock);
+  if (snapshot < 0 || snapshot >= NUM_SNAPSHOTS ||
+      superblock->snapshots[snapshot] != SNAPSHOT_IN_USE) {
+    free(superblock);
+    return -1;
+  }
+
+  // Drop the snapshot as a user of its blocks in one go
+  struct inode_t *inode = (struct inode_t *)malloc(sizeof(struct inode_t));
+  int blocknums[NUM_INODES * MAX_FILE_SIZE];
+  int count = 0;
+  for (int i = 0; i < NUM_INODES; i++) {
+    simplefs_readSnapshotInode(snapshot, i, inode);
+    if (inode->status != INODE_IN_USE)
+      continue;
+    for (int j = 0; j < MAX_FILE_SIZE; j++)
+      if (inode->direct_blocks[j] != -1)
+        blocknums[count++] = inode->direct_blocks[j];
+  }
+  free(inode);
+  simplefs_freeDataBlocks(blocknums, count);
+
+  // Free the slot
+  simplefs_lockMetadata();
+  simplefs_readSuperBlock(superblock);
+  superblock->snapshots[snapshot] = SNAPSHOT_FREE;
+  simplefs_writeSuperBlock(superblock);
+  simplefs_unlockMetadata();
+  free(superblock);
+
+  // Close handles still reading from it
+  for (int i = 0; i < MAX_OPEN_FILES; i++) {
+    if (file_handle_array[i].snapshot != snapshot)
+      continue;
+    file_handle_array[i].inode_number = -1;
+    file_handle_array[i].offset = 0;
+    file_handle_array[i].snapshot = -1;
+    file_handle_array[i].flags = 0;
+  }
+  return 0;
+}
+
+// open file `filename` as it was in snapshot `snapshot`, read-only
+int simplefs_snapshot_open(int snapshot, char *filename) {
+  struct superblock_t *superblock =
+      (struct superblock_t *)malloc(sizeof(struct superblock_t));
+  simplefs_readSuperBlock(superblock);
+  int valid = snapshot >= 0 && snapshot < NUM_SNAPSHOTS &&
+              superblock->snapshots[snapshot] == SNAPSHOT_IN_USE;
+  free(superblock);
+  if (!valid)
+    return -1;
+
+  // Find the file in the snapshot
+  struct inode_t *inode = (struct inode_t *)malloc(sizeof(struct inode_t));
+  int inodenum = simplefs_lookupInode(snapshot, filename, inode);
+  free(inode); // Free malloced data
+  if (inodenum == -1)
+    return -1;
+
+  // Check free file handle and assign it
+  for (int file_handle = 0; file_handle < MAX_OPEN_FILES; file_handle++) {
+    if (file_handle_array[file_handle].inode_number != -1)
+      continue;
+    file_handle_array[file_handle].inode_number = inodenum;
+    file_handle_array[file_handle].offset = 0;
+    file_handle_array[file_handle].snapshot = snapshot;
+    file_handle_array[file_handle].flags = 0;
+    return file_handle;
+  }
+  return -1;
+}
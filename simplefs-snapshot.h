@@ -0,0 +1,12 @@
+// CLONES AND SNAPSHOTS
+#ifndef SIMPLEFS_SNAPSHOT_H
+#define SIMPLEFS_SNAPSHOT_H
+
+#include "simplefs-disk.h"
+
+int simplefs_clone(char *src, char *dst);
+int simplefs_snapshot();
+int simplefs_snapshot_delete(int snapshot);
+int simplefs_snapshot_open(int snapshot, char *filename);
+
+#endif
@@ -0,0 +1,162 @@
+#include "simplefs-stripe.h"
+
+#include <pthread.h>
+#include <sys/uio.h>
+
+// pointer to simplefs.txt
+extern int DISK_FD;
+// Image files the data blocks are striped over, 1 if not striped
+extern int STRIPE_MEMBERS;
+// Consecutive data blocks stored on one member before moving to the next
+extern int STRIPE_UNIT;
+
+// Images "simplefs.1" on, holding the data blocks of the other members. The
+// first member is the disk itself
+static int member_fd[MAX_STRIPE_MEMBERS] = {-1, -1, -1, -1};
+
+// Part of a striped request going to one member
+struct stripe_job_t {
+  int fd;
+  int write;
+  off_t offset; // of the first block on the member
+  struct iovec iov[NUM_DATA_BLOCKS];
+  int iovcnt;
+  int nbytes;
+};
+
+// Blocks of a member before the data blocks: the whole metadata on the
+// first member, a copy of the superblock on the others
+static int simplefs_memberStart(int member) {
+  return member == 0 ? DATA_BLOCK_START : 1;
+}
+
+// Size in bytes of member `member` of a set of `members` members
+static int simplefs_memberSize(int members, int unit) {
+  int stripes = (NUM_DATA_BLOCKS + unit - 1) / unit;
+  return (1 + (stripes + members - 1) / members * unit) * BLOCKSIZE;
+}
+
+// Close the members beyond the first one
+static void simplefs_closeStripes() {
+  for (int i = 1; i < MAX_STRIPE_MEMBERS; i++) {
+    if (member_fd[i] != -1)
+      close(member_fd[i]);
+    member_fd[i] = -1;
+  }
+}
+
+// Open the members of the disk described by `superblock`, or with `create`
+// set make them afresh, labelled with a copy of `superblock`. A member is
+// only taken if its label matches its place in the set. Returns -1 if one
+// is missing or belongs elsewhere, the disk then counts as unstriped
+int simplefs_openStripes(struct superblock_t *superblock, int create) {
+  simplefs_closeStripes();
+  STRIPE_MEMBERS = 1;
+  STRIPE_UNIT = 1;
+  int members = superblock->stripe_members;
+  if (members <= 1)
+    return 0;
+  if (members > MAX_STRIPE_MEMBERS || superblock->stripe_unit < 1)
+    return -1;
+
+  int ret = 0;
+  for (int i = 1; i < members && ret == 0; i++) {
+    char name[16];
+    sprintf(name, "simplefs.%d", i);
+    member_fd[i] = open(name, create ? O_RDWR | O_CREAT | O_TRUNC : O_RDWR,
+                        0644);
+    if (member_fd[i] == -1) {
+      ret = -1;
+      continue;
+    }
+
+    // Label a new member, check the label of an old one
+    char tempBuf[BLOCKSIZE];
+    struct superblock_t label;
+    if (create) {
+      label = *superblock;
+      label.stripe_index = i;
+      memset(tempBuf, 0, BLOCKSIZE);
+      memcpy(tempBuf, &label, sizeof(struct superblock_t));
+      int size = simplefs_memberSize(members, superblock->stripe_unit);
+      if (pwrite(member_fd[i], tempBuf, BLOCKSIZE, 0) != BLOCKSIZE ||
+          ftruncate(member_fd[i], size) == -1)
+        ret = -1;
+    } else {
+      if (pread(member_fd[i], tempBuf, BLOCKSIZE, 0) != BLOCKSIZE)
+        memset(tempBuf, 0, BLOCKSIZE);
+      memcpy(&label, tempBuf, sizeof(struct superblock_t));
+      if (memcmp(label.name, "simplefs", 8) ||
+          label.stripe_members != members ||
+          label.stripe_unit != superblock->stripe_unit ||
+          label.stripe_set != superblock->stripe_set ||
+          label.stripe_index != i)
+        ret = -1;
+    }
+  }
+  if (ret == -1) {
+    simplefs_closeStripes();
+    return -1;
+  }
+  STRIPE_MEMBERS = members;
+  STRIPE_UNIT = superblock->stripe_unit;
+  return 0;
+}
+
+// Carry out the part of a request for one member
+static void *simplefs_stripeWorker(void *arg) {
+  struct stripe_job_t *job = (struct stripe_job_t *)arg;
+  int ret = job->write ? pwritev(job->fd, job->iov, job->iovcnt, job->offset)
+                       : preadv(job->fd, job->iov, job->iovcnt, job->offset);
+  assert(ret == job->nbytes);
+  return NULL;
+}
+
+// read (`write` clear) or write `count` consecutive data blocks from
+// `blocknum` to or from `buf` on a striped disk. Each member gets one call,
+// the blocks of a run that land on it being consecutive there as well, and
+// members are served in parallel
+void simplefs_stripeIO(int write, int blocknum, int count, char *buf) {
+  assert(blocknum >= 0 && blocknum + count <= NUM_DATA_BLOCKS);
+  struct stripe_job_t jobs[MAX_STRIPE_MEMBERS];
+  for (int i = 0; i < STRIPE_MEMBERS; i++) {
+    jobs[i].fd = i == 0 ? DISK_FD : member_fd[i];
+    jobs[i].write = write;
+    jobs[i].iovcnt = 0;
+    jobs[i].nbytes = 0;
+  }
+
+  // Split the run at stripe boundaries
+  for (int b = blocknum, run; b < blocknum + count; b += run) {
+    int stripe = b / STRIPE_UNIT;
+    int member = stripe % STRIPE_MEMBERS;
+    run = STRIPE_UNIT - b % STRIPE_UNIT;
+    if (run > blocknum + count - b)
+      run = blocknum + count - b;
+    struct stripe_job_t *job = &jobs[member];
+    if (job->iovcnt == 0) {
+      int local = stripe / STRIPE_MEMBERS * STRIPE_UNIT + b % STRIPE_UNIT;
+      job->offset = (off_t)(simplefs_memberStart(member) + local) * BLOCKSIZE;
+    }
+    job->iov[job->iovcnt].iov_base = buf + (b - blocknum) * BLOCKSIZE;
+    job->iov[job->iovcnt].iov_len = run * BLOCKSIZE;
+    job->iovcnt++;
+    job->nbytes += run * BLOCKSIZE;
+  }
+
+  // One thread per extra member, the caller takes the first one it finds
+  pthread_t threads[MAX_STRIPE_MEMBERS];
+  int first = -1;
+  for (int i = 0; i < STRIPE_MEMBERS; i++) {
+    if (jobs[i].iovcnt == 0)
+      continue;
+    if (first == -1)
+      first = i;
+    else
+      pthread_create(&threads[i], NULL, simplefs_stripeWorker, &jobs[i]);
+  }
+  simplefs_stripeWorker(&jobs[first]);
+  for (int i = first + 1; i < STRIPE_MEMBERS; i++)
+    if (jobs[i].iovcnt > 0)
+      pthread_join(threads[i], NULL);
+}
@@ -0,0 +1,13 @@
+// STRIPED DISKS
+#ifndef SIMPLEFS_STRIPE_H
+#define SIMPLEFS_STRIPE_H
+
+#include "simplefs-disk.h"
+
+#define MAX_STRIPE_MEMBERS 4
+
+// Helpers for the disk layer
+int simplefs_openStripes(struct superblock_t *superblock, int create);
+void simplefs_stripeIO(int write, int blocknum, int count, char *buf);
+
+#endif
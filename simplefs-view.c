@@ -0,0 +1,371 @@
+#include "simplefs-view.h"
+#include "simplefs-checksum.h"
+#include "simplefs-compress.h"
+#include "simplefs-ops.h"
+#include "simplefs-shared.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+// pointer to simplefs.txt
+extern int DISK_FD;
+// FEATURE_* flags the disk was formatted with
+extern int DISK_FEATURES;
+// Set once a data block may be shared, so writes check for copy-on-write
+extern int DISK_SHARING;
+// Image files the data blocks are striped over, 1 if not striped
+extern int STRIPE_MEMBERS;
+// Array for storing opened files
+extern struct filehandle_t file_handle_array[MAX_OPEN_FILES];
+
+#define DISK_SIZE (NUM_BLOCKS * BLOCKSIZE)
+
+// Mapping of the disk, made on the first view or mapped file. Views only
+// read through it
+static char *disk_map = NULL;
+static int disk_map_fd = -1;
+// Mappings replaced while views or mapped files used them, by a disk
+// formatted or mounted again or by simplefs_privatizeMappings. They hold
+// private copies and are unmapped with the last user
+static char *retired_maps[MAX_RETIRED_MAPS];
+static int view_pins;
+
+// File range handed out by simplefs_mmap
+struct mapping_t {
+  char *addr;       // NULL if the slot is free
+  int inode_number; // inode of the file
+  int snapshot;     // -1 for live files, else the read-only snapshot
+  int offset;       // start of the range in the file
+  int len;          // bytes in the range
+  int generation;   // of the inode when mapped, to tell it was reused
+  int direct;       // 1 if `addr` points into the disk mapping, else at a
+                    // private copy
+  int pinned;       // 1 if `addr` points into a disk mapping, current or
+                    // retired, rather than at malloced memory
+};
+static struct mapping_t mappings[MAX_MAPPINGS];
+
+// Zeros served for holes
+static const char zero_block[BLOCKSIZE];
+
+// Drop a pin on the disk mapping, unmapping the replaced ones once nothing
+// points into them
+static void simplefs_unpinDisk() {
+  assert(view_pins > 0);
+  if (--view_pins > 0)
+    return;
+  for (int i = 0; i < MAX_RETIRED_MAPS; i++) {
+    if (retired_maps[i] != NULL)
+      munmap(retired_maps[i], DISK_SIZE);
+    retired_maps[i] = NULL;
+  }
+}
+
+// Stop using the disk mapping. While views or mapped files point into it,
+// it is swapped at the same address for a private copy and kept until the
+// last of them goes, so the pointers stay valid but no longer reach the
+// disk. Its direct mappings become private copies, written back by
+// simplefs_msync. Returns -1 if no more mappings can be kept
+static int simplefs_retireDisk() {
+  if (view_pins == 0) {
+    munmap(disk_map, DISK_SIZE);
+    disk_map = NULL;
+    return 0;
+  }
+  int slot = 0;
+  while (slot < MAX_RETIRED_MAPS && retired_maps[slot] != NULL)
+    slot++;
+  if (slot == MAX_RETIRED_MAPS)
+    return -1;
+
+  char copy[DISK_SIZE];
+  memcpy(copy, disk_map, DISK_SIZE);
+  if (mmap(disk_map, DISK_SIZE, PROT_READ | PROT_WRITE,
+           MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == MAP_FAILED)
+    return -1;
+  memcpy(disk_map, copy, DISK_SIZE);
+  for (int i = 0; i < MAX_MAPPINGS; i++)
+    if (mappings[i].addr != NULL)
+      mappings[i].direct = 0;
+  retired_maps[slot] = disk_map;
+  disk_map = NULL;
+  return 0;
+}
+
+// Map the current disk, replacing the mapping of an earlier one. Returns
+// NULL if the disk can't be mapped
+static char *simplefs_mapDisk() {
+  if (disk_map != NULL && disk_map_fd == DISK_FD)
+    return disk_map;
+  if (disk_map != NULL && simplefs_retireDisk() == -1)
+    return NULL;
+
+  char *map =
+      mmap(NULL, DISK_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, DISK_FD, 0);
+  if (map == MAP_FAILED)
+    return NULL;
+  disk_map = map;
+  disk_map_fd = DISK_FD;
+  return disk_map;
+}
+
+// Check data block `blocknum`, as seen through the disk mapping `map`,
+// against its checksum. Returns -1 if they differ
+static int simplefs_verifyMapped(char *map, int blocknum) {
+  int shared = simplefs_lockShared() == 0;
+  simplefs_lockChecksums();
+  int ret = simplefs_verifyChecksums(
+      blocknum, 1, map + (DATA_BLOCK_START + blocknum) * BLOCKSIZE);
+  simplefs_unlockChecksums();
+  if (shared)
+    simplefs_unlockShared();
+  return ret;
+}
+
+// Point `views` at `nbytes` at the current offset of the file pointed by
+// `file_handle`, without copying. Consecutive blocks come back as a single
+// view, holes as zeros. The views stay readable until simplefs_release_view,
+// and show later writes to the same blocks. Returns the number of views, -1
+// if the read crosses the end of file, fails its checksums or can't be served
+int simplefs_read_view(int file_handle, int nbytes, struct view_t *views) {
+  // If nbytes isn't positive, it is invalid
+  if (file_handle >= MAX_OPEN_FILES || nbytes <= 0)
+    return -1;
+
+  // Get the offset and read the inode
+  int offset = file_handle_array[file_handle].offset;
+  int inodenum = file_handle_array[file_handle].inode_number;
+  int snapshot = file_handle_array[file_handle].snapshot;
+  struct inode_t inode;
+  if (snapshot == -1)
+    simplefs_readInode(inodenum, &inode);
+  else
+    simplefs_readSnapshotInode(snapshot, inodenum, &inode);
+
+  // If read crosses boundary, do nothing
+  if (inode.file_size < offset + nbytes)
+    return -1;
+
+  // Compressed data is served from pinned chunk cache entries
+  if (DISK_FEATURES & FEATURE_COMPRESSION &&
+      !(inode.flags & INODE_FLAG_INLINE)) {
+    int count = 0;
+    for (int i = offset / BLOCKSIZE; i * BLOCKSIZE < offset + nbytes; i++) {
+      int ls = i == offset / BLOCKSIZE ? offset % BLOCKSIZE : 0;
+      int len = BLOCKSIZE - ls;
+      if (len > offset + nbytes - i * BLOCKSIZE - ls)
+        len = offset + nbytes - i * BLOCKSIZE - ls;
+      const char *data;
+      int entry = simplefs_pinChunk(inodenum, &inode, i, &data);
+      if (entry == -1) {
+        simplefs_release_view(views, count);
+        return -1;
+      }
+      views[count].data = data + ls;
+      views[count].length = len;
+      views[count].chunk_entry = entry;
+      count++;
+    }
+    return count;
+  }
+
+  // Data blocks striped over several images have no single mapping
+  if (STRIPE_MEMBERS > 1 && !(inode.flags & INODE_FLAG_INLINE))
+    return -1;
+
+  char *map = simplefs_mapDisk();
+  if (map == NULL)
+    return -1;
+  view_pins++;
+
+  // Inline data is viewed inside the mapped inode
+  if (inode.flags & INODE_FLAG_INLINE) {
+    int inode_offset =
+        snapshot == -1 ? simplefs_inodeOffset(inodenum)
+                       : (SNAPSHOT_START + snapshot * NUM_INODE_BLOCKS) *
+                                 BLOCKSIZE +
+                             inodenum * (int)sizeof(struct inode_t);
+    views[0].data =
+        map + inode_offset + offsetof(struct inode_t, inline_data) + offset;
+    views[0].length = nbytes;
+    views[0].chunk_entry = -1;
+    return 1;
+  }
+
+  // One view per run of consecutive blocks or per hole block
+  int count = 0;
+  int tempset = 0;
+  for (int i = offset / BLOCKSIZE; tempset < nbytes; i++) {
+    int ls = offset + tempset - i * BLOCKSIZE;
+    int len = BLOCKSIZE - ls;
+    if (len > nbytes - tempset)
+      len = nbytes - tempset;
+    int blocknum = inode.direct_blocks[i];
+    if (blocknum != -1 && (DISK_FEATURES & FEATURE_CHECKSUM) &&
+        simplefs_verifyMapped(map, blocknum) == -1) {
+      simplefs_unpinDisk();
+      return -1;
+    }
+
+    // Blocks following the previous one on disk extend its view
+    if (count > 0 && blocknum != -1 && inode.direct_blocks[i - 1] != -1 &&
+        inode.direct_blocks[i - 1] == blocknum - 1) {
+      views[count - 1].length += len;
+    } else {
+      views[count].data =
+          blocknum == -1 ? zero_block + ls
+                         : map + (DATA_BLOCK_START + blocknum) * BLOCKSIZE + ls;
+      views[count].length = len;
+      views[count].chunk_entry = -1;
+      count++;
+    }
+    tempset += len;
+  }
+  return count;
+}
+
+// Release `count` views filled by simplefs_read_view
+void simplefs_release_view(struct view_t *views, int count) {
+  if (count <= 0)
+    return;
+
+  // Unpin the cached chunks behind compressed views
+  if (views[0].chunk_entry != -1) {
+    for (int i = 0; i < count; i++)
+      simplefs_unpinChunk(views[i].chunk_entry);
+    return;
+  }
+
+  simplefs_unpinDisk();
+}
+
+// Map `len` bytes at `offset` of the file pointed by `file_handle` into
+// memory. A range on consecutive blocks of its own in a plain file is
+// returned as a pointer into the disk mapping, so reads and writes through
+// it reach the disk directly. Any other range gets a private copy, read in
+// one go since a whole file fits in a page, and written back by
+// simplefs_msync. A direct pointer becomes a private copy once the file's
+// blocks are shared, moved or freed. Returns NULL if the range crosses the
+// end of file, no mapping slot is free or the range fails its checksums
+char *simplefs_mmap(int file_handle, int offset, int len) {
+  if (file_handle >= MAX_OPEN_FILES || offset < 0 || len <= 0)
+    return NULL;
+  int slot = 0;
+  while (slot < MAX_MAPPINGS && mappings[slot].addr != NULL)
+    slot++;
+  if (slot == MAX_MAPPINGS)
+    return NULL;
+
+  // Read the inode
+  int inodenum = file_handle_array[file_handle].inode_number;
+  int snapshot = file_handle_array[file_handle].snapshot;
+  struct inode_t inode;
+  if (snapshot == -1)
+    simplefs_readInode(inodenum, &inode);
+  else
+    simplefs_readSnapshotInode(snapshot, inodenum, &inode);
+  if (inode.file_size < offset + len)
+    return NULL;
+
+  // Writes through the disk mapping must not bypass the log, compression,
+  // checksums, read-only snapshots or copy-on-write, so only plain blocks of
+  // a live file used by it alone are mapped directly, and only if the disk
+  // isn't striped nor its blocks cached for other processes
+  int first = offset / BLOCKSIZE;
+  int last = (offset + len - 1) / BLOCKSIZE;
+  int direct = snapshot == -1 && STRIPE_MEMBERS == 1 && !simplefs_isShared() &&
+               !(DISK_FEATURES &
+                 (FEATURE_COMPRESSION | FEATURE_LOG | FEATURE_CHECKSUM)) &&
+               !(inode.flags & INODE_FLAG_INLINE);
+  for (int i = first; i <= last && direct; i++)
+    direct = inode.direct_blocks[i] != -1 &&
+             inode.direct_blocks[i] == inode.direct_blocks[first] + i - first &&
+             (!DISK_SHARING ||
+              simplefs_dataBlockRefs(inode.direct_blocks[i]) == 1);
+
+  char *addr = NULL;
+  char *map = direct ? simplefs_mapDisk() : NULL;
+  if (map != NULL) {
+    addr = map + (DATA_BLOCK_START + inode.direct_blocks[first]) * BLOCKSIZE +
+           offset % BLOCKSIZE;
+    view_pins++;
+  } else {
+    direct = 0;
+    addr = (char *)malloc(len);
+    if (simplefs_readFile(inodenum, &inode, offset, addr, len) == -1) {
+      free(addr);
+      return NULL;
+    }
+  }
+
+  mappings[slot].addr = addr;
+  mappings[slot].inode_number = inodenum;
+  mappings[slot].snapshot = snapshot;
+  mappings[slot].offset = offset;
+  mappings[slot].len = len;
+  mappings[slot].generation = simplefs_inodeGeneration(inodenum);
+  mappings[slot].direct = direct;
+  mappings[slot].pinned = direct;
+  return addr;
+}
+
+// Mapping slot handed out for `addr`, -1 if there is none
+static int simplefs_findMapping(char *addr) {
+  for (int i = 0; i < MAX_MAPPINGS; i++)
+    if (addr != NULL && mappings[i].addr == addr)
+      return i;
+  return -1;
+}
+
+// Write changes made through `addr`, returned by simplefs_mmap, to the
+// disk. Private copies go through the usual write path. Returns -1 if
+// `addr` isn't mapped, maps a snapshot or its file was deleted since
+int simplefs_msync(char *addr) {
+  int slot = simplefs_findMapping(addr);
+  if (slot == -1 || mappings[slot].snapshot != -1 ||
+      simplefs_inodeGeneration(mappings[slot].inode_number) !=
+          mappings[slot].generation)
+    return -1;
+
+  // Direct pointers only need the pages flushed
+  if (mappings[slot].direct) {
+    uintptr_t page = (uintptr_t)addr & ~(uintptr_t)(sysconf(_SC_PAGESIZE) - 1);
+    return msync((void *)page, (uintptr_t)addr + mappings[slot].len - page,
+                 MS_SYNC);
+  }
+
+  struct inode_t inode;
+  simplefs_readInode(mappings[slot].inode_number, &inode);
+  if (inode.status != INODE_IN_USE)
+    return -1;
+  return simplefs_writeFile(mappings[slot].inode_number, &inode,
+                            mappings[slot].offset, addr, mappings[slot].len);
+}
+
+// Turn the direct mappings of inode `inodenum`, or of every inode if it is
+// -1, into private copies, before its blocks gain users, move or are freed
+// and writes through them would land in blocks it no longer owns alone.
+// Returns -1 if they can't be
+int simplefs_privatizeMappings(int inodenum) {
+  for (int i = 0; i < MAX_MAPPINGS; i++)
+    if (mappings[i].addr != NULL && mappings[i].direct &&
+        (inodenum == -1 || mappings[i].inode_number == inodenum))
+      return simplefs_retireDisk();
+  return 0;
+}
+
+// Drop the mapping at `addr` returned by simplefs_mmap. Changes to a private
+// copy not written by simplefs_msync are lost. Returns -1 if `addr` isn't
+// mapped
+int simplefs_munmap(char *addr) {
+  int slot = simplefs_findMapping(addr);
+  if (slot == -1)
+    return -1;
+  if (mappings[slot].pinned)
+    simplefs_unpinDisk();
+  else
+    free(addr);
+  mappings[slot].addr = NULL;
+  return 0;
+}
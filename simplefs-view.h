@@ -0,0 +1,27 @@
+// ZERO-COPY READS AND MAPPED FILES
+#ifndef SIMPLEFS_VIEW_H
+#define SIMPLEFS_VIEW_H
+
+#include "simplefs-disk.h"
+
+#define MAX_VIEW_SEGMENTS MAX_FILE_SIZE
+#define MAX_MAPPINGS 8
+#define MAX_RETIRED_MAPS 4 // replaced disk mappings still pointed into
+
+// Read-only piece of a file returned by simplefs_read_view
+struct view_t {
+  const char *data; // the bytes, valid until simplefs_release_view
+  int length;       // number of bytes at `data`
+  int chunk_entry;  // chunk cache entry pinned for `data`, -1 if none
+};
+
+int simplefs_read_view(int file_handle, int nbytes, struct view_t *views);
+void simplefs_release_view(struct view_t *views, int count);
+char *simplefs_mmap(int file_handle, int offset, int len);
+int simplefs_msync(char *addr);
+int simplefs_munmap(char *addr);
+
+// Helpers for the file operations
+int simplefs_privatizeMappings(int inodenum);
+
+#endif
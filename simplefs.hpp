@@ -0,0 +1,104 @@
+// C++ INTERFACE
+// Header-only layer over the public C API. Files are closed by their
+// destructor and data is passed as std::span. Every call goes through the C
+// API, so this adds no speed of its own. Needs C++20
+#ifndef SIMPLEFS_HPP
+#define SIMPLEFS_HPP
+
+#include <span>
+#include <string>
+#include <utility>
+
+extern "C" {
+#include "simplefs-ops.h"
+}
+
+namespace simplefs {
+
+// The disk the C layer is built for. Its geometry is fixed by simplefs-disk.h
+class Disk {
+public:
+  static constexpr int block_size = BLOCKSIZE;
+  static constexpr int num_blocks = NUM_BLOCKS;
+  static constexpr int num_inodes = NUM_INODES;
+  static constexpr int num_data_blocks = NUM_DATA_BLOCKS;
+  static constexpr int max_file_size = MAX_FILE_SIZE * BLOCKSIZE;
+
+  // Open file, closed when it goes out of scope. Move-only
+  class File {
+  public:
+    File() = default;
+    // Takes over `handle` if it is an open file handle, else stays empty
+    explicit File(int handle) {
+      struct stat_t st;
+      if (simplefs_fstat(handle, &st) == 0)
+        handle_ = handle;
+    }
+    File(File &&other) noexcept : handle_(std::exchange(other.handle_, -1)) {}
+    File &operator=(File &&other) noexcept {
+      if (this != &other) {
+        close();
+        handle_ = std::exchange(other.handle_, -1);
+      }
+      return *this;
+    }
+    File(const File &) = delete;
+    File &operator=(const File &) = delete;
+    ~File() { close(); }
+
+    explicit operator bool() const { return handle_ != -1; }
+    int handle() const { return handle_; }
+
+    void close() {
+      if (handle_ != -1)
+        simplefs_close(handle_);
+      handle_ = -1;
+    }
+
+    // read `buf.size()` bytes at `offset`, 0 on success and -1 on failure
+    // like the C API. Empty files fail
+    int read(std::span<char> buf, int offset) {
+      if (handle_ == -1)
+        return -1;
+      return simplefs_pread(handle_, buf.data(), static_cast<int>(buf.size()),
+                            offset);
+    }
+
+    // write `buf` at `offset`, 0 on success and -1 on failure like the C API.
+    // Empty files fail
+    int write(std::span<const char> buf, int offset) {
+      if (handle_ == -1)
+        return -1;
+      return simplefs_pwrite(handle_, const_cast<char *>(buf.data()),
+                             static_cast<int>(buf.size()), offset);
+    }
+
+  private:
+    int handle_ = -1;
+  };
+
+  static void format(int features = 0) {
+    simplefs_formatDiskWithFeatures(features);
+  }
+  static bool mount() { return simplefs_mountDisk() == 0; }
+  static bool create(const std::string &name) {
+    return simplefs_create(const_cast<char *>(name.c_str())) != -1;
+  }
+  static void remove(const std::string &name) {
+    simplefs_delete(const_cast<char *>(name.c_str()));
+  }
+  static File open(const std::string &name) {
+    return File(simplefs_open(const_cast<char *>(name.c_str())));
+  }
+
+  // Number of free data blocks, kept by the superblock
+  static int freeBlocks() {
+    struct statfs_t statfs;
+    simplefs_statfs(&statfs);
+    return statfs.free_blocks;
+  }
+};
+
+} // namespace simplefs
+
+#endif
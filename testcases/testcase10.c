@@ -0,0 +1,34 @@
+#include "simplefs-ops.h"
+
+int main() {
+
+  simplefs_formatDisk();
+  simplefs_create("fileabc");
+  int fd = simplefs_open("fileabc");
+  char str[] =
+      "!-----------------------64 Bytes of Data-----------------------!";
+  printf("Seek: %d\n", simplefs_seek(fd, BLOCKSIZE * 2));
+  printf("Write Data: %d\n", simplefs_write(fd, str, BLOCKSIZE));
+  printf("Seek: %d\n", simplefs_seek(fd, BLOCKSIZE * 2));
+  printf("Seek: %d\n", simplefs_seek(fd, BLOCKSIZE * 3));
+  char buf[BLOCKSIZE * 2 + 1];
+  buf[BLOCKSIZE * 2] = '\0';
+  printf("Seek: %d\n", simplefs_seek(fd, -BLOCKSIZE * 3));
+  printf("Read Data %d\n", simplefs_read(fd, buf, BLOCKSIZE * 2));
+  int zeros = 0;
+  for (int i = 0; i < BLOCKSIZE * 2; i++)
+    zeros += buf[i] == '\0';
+  printf("Zero Bytes: %d\n", zeros);
+  printf("Seek Data: %d\n", simplefs_seek_data(fd));
+  printf("Read Data %d\n", simplefs_read(fd, buf, BLOCKSIZE));
+  buf[BLOCKSIZE] = '\0';
+  printf("Data: %s\n", buf);
+  printf("Seek Hole: %d\n", simplefs_seek_hole(fd));
+  printf("Seek Data: %d\n", simplefs_seek_data(fd));
+  printf("Seek: %d\n", simplefs_seek(fd, -BLOCKSIZE * 3));
+  printf("Seek Hole: %d\n", simplefs_seek_hole(fd));
+  simplefs_close(fd);
+  simplefs_dump();
+
+  return 0;
+}
@@ -0,0 +1,39 @@
+#include "simplefs-ops.h"
+
+int main() {
+
+  char str[] =
+      "!-----------------------64 Bytes of Data-----------------------!";
+  simplefs_formatDisk();
+
+  simplefs_create("f1.txt");
+  int fd1 = simplefs_open("f1.txt");
+  simplefs_create("f2.txt");
+  int fd2 = simplefs_open("f2.txt");
+
+  printf("Fallocate: %d\n", simplefs_fallocate(fd1, 0, BLOCKSIZE * 3));
+  printf("Write Data: %d\n", simplefs_write(fd1, str, BLOCKSIZE));
+  printf("Write Data: %d\n", simplefs_write(fd2, str, BLOCKSIZE));
+  printf("Seek: %d\n", simplefs_seek(fd1, BLOCKSIZE));
+  printf("Seek: %d\n", simplefs_seek(fd2, BLOCKSIZE));
+  printf("Write Data: %d\n", simplefs_write(fd1, str, BLOCKSIZE));
+  printf("Write Data: %d\n", simplefs_write(fd2, str, BLOCKSIZE));
+  printf("Seek: %d\n", simplefs_seek(fd1, BLOCKSIZE));
+  printf("Write Data: %d\n", simplefs_write(fd1, str, BLOCKSIZE));
+  simplefs_dump();
+
+  printf("Truncate: %d\n", simplefs_truncate(fd1, 100));
+  printf("Truncate: %d\n", simplefs_truncate(fd1, 110));
+  char buf[BLOCKSIZE + 1];
+  buf[BLOCKSIZE] = '\0';
+  printf("Seek: %d\n", simplefs_seek(fd1, -BLOCKSIZE));
+  printf("Read Data %d\n", simplefs_read(fd1, buf, 46));
+  printf("Data: %s\n", buf);
+  printf("Read Data %d\n", simplefs_read(fd1, buf, 47));
+  printf("Truncate: %d\n", simplefs_truncate(fd2, 0));
+  simplefs_close(fd1);
+  simplefs_close(fd2);
+  simplefs_dump();
+
+  return 0;
+}
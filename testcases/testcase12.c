@@ -0,0 +1,38 @@
+#include "simplefs-ops.h"
+
+// Write two blocks to each of two files, interleaved, and print the layout
+void interleave() {
+  char str[] =
+      "!-----------------------64 Bytes of Data-----------------------!";
+  simplefs_create("f1.txt");
+  int fd1 = simplefs_open("f1.txt");
+  simplefs_create("f2.txt");
+  int fd2 = simplefs_open("f2.txt");
+  for (int i = 0; i < 2; i++) {
+    printf("Write Data: %d\n", simplefs_write(fd1, str, BLOCKSIZE));
+    printf("Write Data: %d\n", simplefs_write(fd2, str, BLOCKSIZE));
+    printf("Seek: %d\n", simplefs_seek(fd1, BLOCKSIZE));
+    printf("Seek: %d\n", simplefs_seek(fd2, BLOCKSIZE));
+  }
+  simplefs_close(fd1);
+  simplefs_close(fd2);
+  simplefs_dump();
+
+  struct stats_t stats;
+  simplefs_getStats(&stats);
+  printf("Files: %d\tBlocks: %d\tExtents: %d\tExtents per file: %.2f\n",
+         stats.files, stats.used_blocks, stats.extents,
+         stats.extents_per_file);
+}
+
+int main() {
+
+  simplefs_formatDisk();
+  interleave();
+
+  simplefs_formatDisk();
+  simplefs_setReservationWindow(4);
+  interleave();
+
+  return 0;
+}
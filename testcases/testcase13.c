@@ -0,0 +1,54 @@
+#include "simplefs-defrag.h"
+#include "simplefs-ops.h"
+
+// Print the usage and fragmentation figures
+void print_stats() {
+  struct stats_t stats;
+  simplefs_getStats(&stats);
+  printf("Files: %d\tBlocks: %d\tExtents: %d\tExtents per file: %.2f\n",
+         stats.files, stats.used_blocks, stats.extents,
+         stats.extents_per_file);
+}
+
+int main() {
+
+  char str[] =
+      "!-----------------------64 Bytes of Data-----------------------!";
+  simplefs_formatDisk();
+
+  // Three files written interleaved, then the middle one deleted
+  char fName[] = "0_.txt";
+  int fd[3];
+  for (int i = 0; i < 3; i++) {
+    fName[0] = '0' + i;
+    simplefs_create(fName);
+    fd[i] = simplefs_open(fName);
+  }
+  for (int j = 0; j < 3; j++) {
+    for (int i = 0; i < 3; i++) {
+      simplefs_write(fd[i], str, BLOCKSIZE);
+      simplefs_seek(fd[i], BLOCKSIZE);
+    }
+  }
+  simplefs_close(fd[1]);
+  simplefs_delete("1_.txt");
+  simplefs_dump();
+  print_stats();
+
+  // Defragment in small steps while the files stay open
+  int moved;
+  while ((moved = simplefs_defrag(3)) > 0)
+    printf("Defrag: %d\n", moved);
+  simplefs_dump();
+  print_stats();
+
+  char buf[BLOCKSIZE * 3 + 1];
+  buf[BLOCKSIZE * 3] = '\0';
+  printf("Seek: %d\n", simplefs_seek(fd[2], -BLOCKSIZE * 3));
+  printf("Read Data %d\n", simplefs_read(fd[2], buf, BLOCKSIZE * 3));
+  printf("Data: %s\n", buf);
+  simplefs_close(fd[0]);
+  simplefs_close(fd[2]);
+
+  return 0;
+}
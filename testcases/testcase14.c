@@ -0,0 +1,51 @@
+#include "simplefs-fsck.h"
+#include "simplefs-ops.h"
+
+// Check the disk and print what was found
+void check(int repair) {
+  struct fsck_report_t report;
+  printf("Fsck: %d\n", simplefs_fsck(4, repair, &report));
+  printf("Bad inodes: %d\tDuplicate blocks: %d\tInode map errors: %d\t"
+         "Block map errors: %d\tRepaired: %d\n",
+         report.bad_inodes, report.duplicate_blocks, report.inode_map_errors,
+         report.block_map_errors, report.repaired);
+}
+
+int main() {
+
+  char str[] =
+      "!-----------------------64 Bytes of Data-----------------------!";
+  simplefs_formatDisk();
+  simplefs_create("f1.txt");
+  int fd1 = simplefs_open("f1.txt");
+  simplefs_create("f2.txt");
+  int fd2 = simplefs_open("f2.txt");
+  printf("Write Data: %d\n", simplefs_write(fd1, str, BLOCKSIZE));
+  printf("Write Data: %d\n", simplefs_write(fd2, str, BLOCKSIZE));
+  simplefs_close(fd1);
+  simplefs_close(fd2);
+  check(0);
+
+  // Corrupt the disk: a leaked block, a block shared by two files, a bad
+  // block number and an inode marked free in the free map
+  struct inode_t inode;
+  simplefs_allocDataBlock();
+  simplefs_readInode(1, &inode);
+  inode.direct_blocks[1] = 0;
+  inode.direct_blocks[2] = NUM_DATA_BLOCKS + 5;
+  simplefs_writeInode(1, &inode);
+  simplefs_freeInode(0);
+  simplefs_readInode(0, &inode);
+  inode.status = INODE_IN_USE;
+  strcpy(inode.name, "f1.txt");
+  inode.file_size = BLOCKSIZE;
+  inode.direct_blocks[0] = 0;
+  simplefs_writeInode(0, &inode);
+
+  check(0);
+  check(1);
+  check(0);
+  simplefs_dump();
+
+  return 0;
+}
@@ -0,0 +1,84 @@
+#include "simplefs-dir.h"
+#include "simplefs-fsck.h"
+#include "simplefs-ops.h"
+#include "simplefs-snapshot.h"
+
+int main() {
+
+  char str[] =
+      "!-----------------------64 Bytes of Data-----------------------!";
+  char big[2 * BLOCKSIZE];
+  for (int i = 0; i < 2 * BLOCKSIZE; i++)
+    big[i] = 'a' + i % 26;
+  char buf[2 * BLOCKSIZE + 1];
+  struct fsck_report_t report;
+
+  simplefs_formatDisk();
+  simplefs_create("f1.txt");
+  int fd1 = simplefs_open("f1.txt");
+  printf("Write Data: %d\n", simplefs_write(fd1, big, 2 * BLOCKSIZE));
+
+  // The clone shares both blocks until one side writes
+  printf("Clone: %d\n", simplefs_clone("f1.txt", "f2.txt"));
+  printf("Clone existing: %d\n", simplefs_clone("f1.txt", "f2.txt"));
+  printf("Clone missing: %d\n", simplefs_clone("f9.txt", "f3.txt"));
+  printf("Refs: %d\n", simplefs_dataBlockRefs(0));
+  int fd2 = simplefs_open("f2.txt");
+  printf("Seek: %d\n", simplefs_seek(fd2, 10));
+  printf("Write Data: %d\n", simplefs_write(fd2, "CLONE", 5));
+  printf("Refs: %d %d\n", simplefs_dataBlockRefs(0),
+         simplefs_dataBlockRefs(1));
+  simplefs_seek(fd1, -2 * BLOCKSIZE);
+  simplefs_read(fd1, buf, 2 * BLOCKSIZE);
+  buf[2 * BLOCKSIZE] = '\0';
+  printf("Read Data f1: %s\n", buf);
+  simplefs_seek(fd2, -10);
+  simplefs_read(fd2, buf, 2 * BLOCKSIZE);
+  printf("Read Data f2: %s\n", buf);
+  printf("Fsck: %d\n", simplefs_fsck(2, 0, &report));
+
+  // A snapshot keeps the old data while the live file changes
+  int snap = simplefs_snapshot();
+  printf("Snapshot: %d\n", snap);
+  simplefs_seek(fd1, -2 * BLOCKSIZE);
+  printf("Write Data: %d\n", simplefs_write(fd1, str, BLOCKSIZE));
+  printf("Truncate: %d\n", simplefs_truncate(fd1, BLOCKSIZE + 3));
+  int fds = simplefs_snapshot_open(snap, "f1.txt");
+  printf("Snapshot open: %d\n", fds);
+  printf("Write Snapshot: %d\n", simplefs_write(fds, str, 5));
+  printf("Read Snapshot: %d\n", simplefs_read(fds, buf, 2 * BLOCKSIZE));
+  printf("Read Data snapshot: %s\n", buf);
+  simplefs_seek(fd1, -BLOCKSIZE);
+  simplefs_read(fd1, buf, BLOCKSIZE + 3);
+  buf[BLOCKSIZE + 3] = '\0';
+  printf("Read Data f1: %s\n", buf);
+  printf("Fsck: %d\n", simplefs_fsck(2, 0, &report));
+  simplefs_dump();
+
+  // Deleting the snapshot releases the blocks only it used
+  printf("Snapshot delete: %d\n", simplefs_snapshot_delete(snap));
+  printf("Snapshot delete again: %d\n", simplefs_snapshot_delete(snap));
+  simplefs_close(fd1);
+  simplefs_close(fd2);
+  simplefs_delete("f2.txt");
+  printf("Fsck: %d\n", simplefs_fsck(2, 0, &report));
+  simplefs_dump();
+
+  // Names of the full length are found in a snapshot too
+  simplefs_create("abcdefgh");
+  fd1 = simplefs_open("abcdefgh");
+  simplefs_write(fd1, str, 5);
+  simplefs_close(fd1);
+  snap = simplefs_snapshot();
+  fds = simplefs_snapshot_open(snap, "abcdefgh");
+  printf("Snapshot open full name: %d\n", fds != -1);
+  simplefs_close(fds);
+
+  // Clones need a file as the source and a plain name at the root
+  printf("Clone empty name: %d\n", simplefs_clone("abcdefgh", ""));
+  printf("Clone path: %d\n", simplefs_clone("abcdefgh", "d/f"));
+  simplefs_mkdir("d");
+  printf("Clone directory: %d\n", simplefs_clone("d", "e"));
+
+  return 0;
+}
@@ -0,0 +1,52 @@
+#include "simplefs-ops.h"
+#include "simplefs-view.h"
+
+// Print the views of `nbytes` at the current offset of `fd`
+void view(int fd, int nbytes) {
+  struct view_t views[MAX_VIEW_SEGMENTS];
+  int count = simplefs_read_view(fd, nbytes, views);
+  printf("Views: %d\n", count);
+  for (int i = 0; i < count; i++) {
+    printf("View %d (%d): ", i, views[i].length);
+    for (int j = 0; j < views[i].length; j++)
+      putchar(views[i].data[j] ? views[i].data[j] : '.');
+    putchar('\n');
+  }
+  simplefs_release_view(views, count);
+}
+
+int main() {
+
+  char str[] =
+      "!-----------------------64 Bytes of Data-----------------------!";
+
+  simplefs_formatDisk();
+  simplefs_create("f1.txt");
+  int fd1 = simplefs_open("f1.txt");
+  simplefs_write(fd1, "inline", 6);
+  view(fd1, 6);
+
+  // Consecutive blocks share a view, holes get their own
+  simplefs_write(fd1, str, BLOCKSIZE);
+  simplefs_seek(fd1, BLOCKSIZE);
+  simplefs_write(fd1, str, BLOCKSIZE);
+  simplefs_seek(fd1, 2 * BLOCKSIZE);
+  simplefs_write(fd1, str, BLOCKSIZE);
+  simplefs_seek(fd1, -3 * BLOCKSIZE + 60);
+  view(fd1, 3 * BLOCKSIZE - 8);
+  view(fd1, 4 * BLOCKSIZE);
+  simplefs_seek(fd1, -60);
+  view(fd1, 4 * BLOCKSIZE);
+
+  // Compressed files are viewed in the chunk cache
+  simplefs_formatDiskWithFeatures(FEATURE_COMPRESSION);
+  simplefs_create("f2.txt");
+  int fd2 = simplefs_open("f2.txt");
+  simplefs_write(fd2, str, BLOCKSIZE);
+  simplefs_seek(fd2, BLOCKSIZE);
+  simplefs_write(fd2, str, BLOCKSIZE);
+  simplefs_seek(fd2, -BLOCKSIZE + 32);
+  view(fd2, BLOCKSIZE);
+
+  return 0;
+}
@@ -0,0 +1,40 @@
+#include "simplefs-ops.h"
+
+int main() {
+
+  char str[] =
+      "!-----------------------64 Bytes of Data-----------------------!";
+  char buf[BLOCKSIZE + 1];
+
+  simplefs_formatDisk();
+  simplefs_create("f1.txt");
+  int fd1 = simplefs_open("f1.txt");
+
+  // Positional I/O leaves the handle offset alone
+  printf("Pwrite: %d\n", simplefs_pwrite(fd1, str, BLOCKSIZE, BLOCKSIZE));
+  printf("Pwrite: %d\n", simplefs_pwrite(fd1, "head", 4, 0));
+  printf("Pwrite past end: %d\n",
+         simplefs_pwrite(fd1, str, BLOCKSIZE, 4 * BLOCKSIZE - 8));
+  printf("Pread: %d\n", simplefs_pread(fd1, buf, 20, BLOCKSIZE + 20));
+  buf[20] = '\0';
+  printf("Read Data: %s\n", buf);
+  printf("Pread past end: %d\n", simplefs_pread(fd1, buf, 8, 2 * BLOCKSIZE - 4));
+  printf("Read: %d\n", simplefs_read(fd1, buf, 4));
+  buf[4] = '\0';
+  printf("Read Data: %s\n", buf);
+
+  // Scatter/gather at the handle offset
+  char a[10], b[8], c[4];
+  struct iovec out[3] = {{"first-", 6}, {"second-", 7}, {"third", 5}};
+  struct iovec in[3] = {{a, sizeof(a)}, {b, sizeof(b)}, {c, sizeof(c)}};
+  simplefs_seek(fd1, 4);
+  printf("Writev: %d\n", simplefs_writev(fd1, out, 3));
+  simplefs_seek(fd1, -4);
+  printf("Readv: %d\n", simplefs_readv(fd1, in, 3));
+  printf("Read Data: %.10s|%.8s|%.4s\n", a, b, c);
+  printf("Readv empty: %d\n", simplefs_readv(fd1, in, 0));
+  simplefs_close(fd1);
+  simplefs_dump();
+
+  return 0;
+}
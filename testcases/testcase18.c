@@ -0,0 +1,47 @@
+#include "simplefs-batch.h"
+
+int main() {
+
+  char str[] =
+      "!-----------------------64 Bytes of Data-----------------------!";
+  char names[4][MAX_NAME_STRLEN] = {"f1.txt", "f2.txt", "f3.txt", "f4.txt"};
+  struct batch_op_t ops[20];
+  char buf[4][BLOCKSIZE + 1];
+  int n = 0;
+
+  // Create, fill and close files in one batch
+  simplefs_formatDisk();
+  for (int i = 0; i < 4; i++) {
+    ops[n++] = (struct batch_op_t){BATCH_CREATE, names[i]};
+    ops[n++] = (struct batch_op_t){BATCH_OPEN, names[i]};
+    ops[n++] = (struct batch_op_t){BATCH_WRITE, NULL, BATCH_LAST_OPEN, str,
+                                   (i + 1) * 16, i * 16};
+    ops[n++] = (struct batch_op_t){BATCH_CLOSE, NULL, BATCH_LAST_OPEN};
+  }
+  ops[n++] = (struct batch_op_t){BATCH_CREATE, names[0]};
+  ops[n++] = (struct batch_op_t){BATCH_WRITE, NULL, BATCH_LAST_OPEN, str, 4};
+  printf("Failed: %d\n", simplefs_submit(ops, n));
+  for (int i = 0; i < n; i++)
+    printf("Op %d: %d\n", ops[i].op, ops[i].result);
+
+  // Read them back and delete one in another batch
+  n = 0;
+  for (int i = 0; i < 4; i++)
+    ops[n++] = (struct batch_op_t){BATCH_OPEN, names[i]};
+  for (int i = 0; i < 4; i++) {
+    memset(buf[i], 0, sizeof(buf[i]));
+    ops[n++] = (struct batch_op_t){BATCH_READ, NULL, i, buf[i], (i + 1) * 16,
+                                   0};
+  }
+  ops[n++] = (struct batch_op_t){BATCH_DELETE, names[1]};
+  ops[n++] = (struct batch_op_t){BATCH_READ, NULL, 0, buf[0], BLOCKSIZE, 0};
+  printf("Failed: %d\n", simplefs_submit(ops, n));
+  for (int i = 0; i < 4; i++) {
+    for (int j = 0; j < (i + 1) * 16; j++)
+      putchar(buf[i][j] ? buf[i][j] : '.');
+    putchar('\n');
+  }
+  simplefs_dump();
+
+  return 0;
+}
@@ -0,0 +1,72 @@
+#include "simplefs-ops.h"
+
+#include <pthread.h>
+
+#define RECORD 8
+#define THREADS 4
+#define RECORDS_PER_THREAD 8
+
+int fds[THREADS];
+
+// Append records of a single letter through a handle of its own
+void *appender(void *arg) {
+  int id = (int)(long)arg;
+  char record[RECORD];
+  memset(record, 'a' + id, RECORD);
+  for (int i = 0; i < RECORDS_PER_THREAD; i++)
+    simplefs_write(fds[id], record, RECORD);
+  return NULL;
+}
+
+int main() {
+
+  char buf[MAX_FILE_SIZE * BLOCKSIZE + 1];
+
+  simplefs_formatDisk();
+  simplefs_create("log.txt");
+
+  // Appends ignore the offset and are seen by other handles
+  int fd1 = simplefs_open_append("log.txt");
+  int fd2 = simplefs_open("log.txt");
+  printf("Write Data: %d\n", simplefs_write(fd1, "head-", 5));
+  printf("Seek: %d\n", simplefs_seek(fd1, 100));
+  printf("Write Data: %d\n", simplefs_write(fd1, "tail", 4));
+  printf("Read: %d\n", simplefs_read(fd2, buf, 9));
+  buf[9] = '\0';
+  printf("Read Data: %s\n", buf);
+  printf("Truncate: %d\n", simplefs_truncate(fd2, 0));
+  simplefs_close(fd1);
+  simplefs_close(fd2);
+
+  // Records appended from several threads never interleave
+  pthread_t threads[THREADS];
+  for (int i = 0; i < THREADS; i++)
+    fds[i] = simplefs_open_append("log.txt");
+  for (long i = 0; i < THREADS; i++)
+    pthread_create(&threads[i], NULL, appender, (void *)i);
+  for (int i = 0; i < THREADS; i++) {
+    pthread_join(threads[i], NULL);
+    simplefs_close(fds[i]);
+  }
+
+  fd1 = simplefs_open("log.txt");
+  int size = THREADS * RECORDS_PER_THREAD * RECORD;
+  printf("Read: %d\n", simplefs_read(fd1, buf, size));
+  int records[THREADS] = {0}, torn = 0;
+  for (int i = 0; i < size; i += RECORD) {
+    for (int j = 1; j < RECORD; j++)
+      torn += buf[i + j] != buf[i];
+    records[buf[i] - 'a']++;
+  }
+  printf("Torn: %d\n", torn);
+  for (int i = 0; i < THREADS; i++)
+    printf("Records %c: %d\n", 'a' + i, records[i]);
+  simplefs_close(fd1);
+
+  // A full file takes no more appends
+  fd1 = simplefs_open_append("log.txt");
+  printf("Write Data: %d\n", simplefs_write(fd1, "x", 1));
+  simplefs_close(fd1);
+
+  return 0;
+}
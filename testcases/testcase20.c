@@ -0,0 +1,100 @@
+#include "simplefs-fsck.h"
+#include "simplefs-log.h"
+#include "simplefs-ops.h"
+
+// Number of segments without live blocks
+int clean_segments() {
+  struct superblock_t superblock;
+  simplefs_lockMetadata();
+  simplefs_readSuperBlock(&superblock);
+  simplefs_unlockMetadata();
+  int count = 0;
+  for (int s = 0; s < NUM_SEGMENTS; s++) {
+    int clean = 1;
+    for (int i = 0; i < SEGMENT_BLOCKS; i++)
+      clean &= superblock.datablock_freelist[s * SEGMENT_BLOCKS + i] ==
+               DATA_BLOCK_FREE;
+    count += clean;
+  }
+  return count;
+}
+
+int main() {
+
+  char str[] =
+      "!-----------------------64 Bytes of Data-----------------------!";
+  char buf[BLOCKSIZE + 1];
+  struct fsck_report_t report;
+
+  // Every write goes to the head of the log, old copies are freed
+  simplefs_formatDiskWithFeatures(FEATURE_LOG);
+  simplefs_create("f1.txt");
+  simplefs_create("f2.txt");
+  int fd1 = simplefs_open("f1.txt");
+  int fd2 = simplefs_open("f2.txt");
+  printf("Write Data: %d\n", simplefs_write(fd1, str, BLOCKSIZE));
+  printf("Write Data: %d\n", simplefs_write(fd2, str, BLOCKSIZE));
+  for (int i = 0; i < 4; i++) {
+    printf("Write Data: %d\n", simplefs_write(fd1, "abcd", 4));
+    simplefs_seek(fd1, 4);
+  }
+  simplefs_seek(fd1, -16);
+  printf("Read: %d\n", simplefs_read(fd1, buf, BLOCKSIZE));
+  buf[BLOCKSIZE] = '\0';
+  printf("Read Data: %s\n", buf);
+  printf("Fsck: %d\n", simplefs_fsck(2, 0, &report));
+  simplefs_dump();
+
+  // The cleaner empties segments left with few live blocks
+  for (int i = 0; i < 6; i++)
+    simplefs_write(fd2, "wxyz", 4);
+  printf("Clean: %d\n", simplefs_clean(NUM_SEGMENTS));
+  printf("Clean: %d\n", simplefs_clean(NUM_SEGMENTS));
+  printf("Fsck: %d\n", simplefs_fsck(2, 0, &report));
+  simplefs_close(fd1);
+  simplefs_close(fd2);
+  simplefs_delete("f1.txt");
+
+  // The inode map survives a remount
+  printf("Mount: %d\n", simplefs_mountDisk());
+  fd2 = simplefs_open("f2.txt");
+  printf("Read: %d\n", simplefs_read(fd2, buf, BLOCKSIZE));
+  printf("Read Data: %s\n", buf);
+  simplefs_close(fd2);
+  simplefs_dump();
+
+  // Files written side by side, then every other one deleted, leave no
+  // segment clean. The cleaner thread empties segments in the background
+  // until CLEAN_MIN_SEGMENTS are clean
+  char names[5][MAX_NAME_STRLEN] = {"g0", "g1", "g2", "g3", "g4"};
+  int fds[5];
+  for (int i = 0; i < 5; i++) {
+    simplefs_create(names[i]);
+    fds[i] = simplefs_open(names[i]);
+  }
+  for (int j = 0; j < MAX_FILE_SIZE; j++)
+    for (int i = 0; i < 5; i++)
+      simplefs_pwrite(fds[i], str, BLOCKSIZE, j * BLOCKSIZE);
+  for (int i = 0; i < 5; i++)
+    simplefs_close(fds[i]);
+  for (int i = 0; i < 5; i += 2)
+    simplefs_delete(names[i]);
+  printf("Clean segments: %d\n", clean_segments());
+  printf("Start cleaner: %d\n", simplefs_startCleaner());
+  printf("Start again: %d\n", simplefs_startCleaner());
+  for (int n = 0; n < 5000 && clean_segments() < CLEAN_MIN_SEGMENTS; n++)
+    usleep(1000);
+  simplefs_stopCleaner();
+  printf("Clean segments: %d\n", clean_segments());
+  printf("Fsck: %d\n", simplefs_fsck(2, 0, &report));
+
+  // The log goes on after a remount where it left off, rather than from the
+  // start of the disk
+  printf("Mount: %d\n", simplefs_mountDisk());
+  fd2 = simplefs_open("f2.txt");
+  printf("Write Data: %d\n", simplefs_write(fd2, "abcd", 4));
+  simplefs_close(fd2);
+  simplefs_dump();
+
+  return 0;
+}
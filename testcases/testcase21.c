@@ -0,0 +1,54 @@
+#include "simplefs-ops.h"
+
+// Print what file `name` holds, its own name if it is the right one
+void check(char *name) {
+  char buf[MAX_NAME_STRLEN + 1];
+  memset(buf, 0, sizeof(buf));
+  int fd = simplefs_open(name);
+  if (fd == -1) {
+    printf("Open %s: -1\n", name);
+    return;
+  }
+  simplefs_read(fd, buf, strlen(name));
+  printf("Open %s: holds %s\n", name, buf);
+  simplefs_close(fd);
+}
+
+int main() {
+
+  // Names sharing prefixes, up to the full eight bytes
+  char names[6][MAX_NAME_STRLEN + 1] = {"a",     "ab",       "abc",
+                                        "abcd1", "abcdefgh", "abcdefg"};
+  simplefs_formatDisk();
+  for (int i = 0; i < 6; i++) {
+    printf("Create %s: %d\n", names[i], simplefs_create(names[i]));
+    int fd = simplefs_open(names[i]);
+    simplefs_write(fd, names[i], strlen(names[i]));
+    simplefs_close(fd);
+  }
+  printf("Create again: %d\n", simplefs_create("abc"));
+  printf("Create long name: %d\n", simplefs_create("abcdefghi"));
+
+  // Each name opens its own file
+  for (int i = 0; i < 6; i++)
+    check(names[i]);
+  check("abcde");
+  check("abcdefghi");
+  simplefs_delete("abcde");
+
+  // A freed inode is found again under its new name
+  simplefs_delete("ab");
+  check("ab");
+  printf("Create b: %d\n", simplefs_create("b"));
+  int fd = simplefs_open("b");
+  simplefs_write(fd, "b", 1);
+  simplefs_close(fd);
+
+  // The table is read back from disk after mounting
+  simplefs_mountDisk();
+  check("b");
+  check("ab");
+  check("abcdefgh");
+  simplefs_dump();
+  return 0;
+}
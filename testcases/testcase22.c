@@ -0,0 +1,69 @@
+#include "simplefs-dir.h"
+#include "simplefs-ops.h"
+
+// Print what file `path` holds
+void check(char *path) {
+  char buf[DIR_NAME_LEN + 1];
+  memset(buf, 0, sizeof(buf));
+  int fd = simplefs_open(path);
+  if (fd == -1) {
+    printf("Open %s: -1\n", path);
+    return;
+  }
+  simplefs_read(fd, buf, 8);
+  printf("Open %s: holds %s\n", path, buf);
+  simplefs_close(fd);
+}
+
+int main() {
+
+  char names[5][64] = {"docs/readme-for-the-project", "docs/a", "docs/b",
+                       "docs/notes/2024-summary.txt", "docs/notes/todo"};
+  simplefs_formatDisk();
+  printf("Mkdir docs: %d\n", simplefs_mkdir("docs"));
+  printf("Mkdir docs/notes: %d\n", simplefs_mkdir("docs/notes"));
+  printf("Mkdir docs again: %d\n", simplefs_mkdir("docs"));
+  printf("Mkdir missing parent: %d\n", simplefs_mkdir("nope/x"));
+
+  // Long names only fit inside directories
+  printf("Create too long: %d\n",
+         simplefs_create("docs/a-name-longer-than-24-bytes"));
+  for (int i = 0; i < 5; i++) {
+    printf("Create %s: %d\n", names[i], simplefs_create(names[i]));
+    int fd = simplefs_open(names[i]);
+    simplefs_write(fd, names[i] + 5, 8);
+    simplefs_close(fd);
+  }
+  printf("Create again: %d\n", simplefs_create("docs/a"));
+  printf("Create at root: %d\n", simplefs_create("top"));
+
+  for (int i = 0; i < 5; i++)
+    check(names[i]);
+  check("/docs//notes/todo");
+  check("docs");
+  check("a");
+  check("docs/c");
+
+  // Directories go only once empty
+  printf("Rmdir docs/notes: %d\n", simplefs_rmdir("docs/notes"));
+  simplefs_delete("docs/notes");
+  check("docs/notes/todo");
+
+  // Names past a deleted one are still found, and the slot is reused
+  simplefs_delete("docs/a");
+  check("docs/a");
+  check("docs/b");
+  check("docs/readme-for-the-project");
+  printf("Create docs/c: %d\n", simplefs_create("docs/c"));
+
+  // Everything is read back from disk after mounting
+  simplefs_mountDisk();
+  check("docs/notes/2024-summary.txt");
+  check("docs/b");
+  simplefs_delete("docs/notes/todo");
+  simplefs_delete("docs/notes/2024-summary.txt");
+  printf("Rmdir docs/notes: %d\n", simplefs_rmdir("docs/notes"));
+  printf("Rmdir file: %d\n", simplefs_rmdir("docs/b"));
+  simplefs_dump();
+  return 0;
+}
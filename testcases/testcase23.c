@@ -0,0 +1,81 @@
+#include "simplefs-fsck.h"
+#include "simplefs-ops.h"
+#include "simplefs-reclaim.h"
+
+int main() {
+
+  char str[] =
+      "!-----------------------64 Bytes of Data-----------------------!";
+  char names[NUM_INODES][MAX_NAME_STRLEN] = {"f0", "f1", "f2", "f3",
+                                             "f4", "f5", "f6", "f7"};
+  char block[MAX_FILE_SIZE * BLOCKSIZE];
+  for (int i = 0; i < MAX_FILE_SIZE; i++)
+    memcpy(block + i * BLOCKSIZE, str, BLOCKSIZE);
+
+  // Fill every inode and data block
+  simplefs_formatDisk();
+  printf("Start: %d\n", simplefs_startReclaimer());
+  printf("Start again: %d\n", simplefs_startReclaimer());
+  for (int i = 0; i < NUM_INODES; i++) {
+    simplefs_create(names[i]);
+    int fd = simplefs_open(names[i]);
+    int blocks = i < 7 ? MAX_FILE_SIZE : NUM_DATA_BLOCKS - 7 * MAX_FILE_SIZE;
+    printf("Write %s: %d\n", names[i],
+           simplefs_write(fd, block, blocks * BLOCKSIZE));
+    simplefs_close(fd);
+  }
+
+  // Deleted files give their inode and blocks back, whether the reclaimer
+  // got to them first or the allocation reclaims them itself
+  simplefs_delete("f1");
+  simplefs_delete("f2");
+  printf("Open deleted: %d\n", simplefs_open("f1"));
+  printf("Create g1: %d\n", simplefs_create("g1"));
+  printf("Create g2: %d\n", simplefs_create("g2"));
+  int fd = simplefs_open("g1");
+  printf("Write g1: %d\n",
+         simplefs_write(fd, block, MAX_FILE_SIZE * BLOCKSIZE));
+  simplefs_close(fd);
+  fd = simplefs_open("g2");
+  printf("Write g2: %d\n",
+         simplefs_write(fd, block, MAX_FILE_SIZE * BLOCKSIZE));
+  simplefs_close(fd);
+  printf("Create when full: %d\n", simplefs_create("g3"));
+  simplefs_stopReclaimer();
+
+  // An orphan left by a crash is a valid user until mount reclaims it
+  struct inode_t inode;
+  simplefs_readInode(3, &inode);
+  inode.status = INODE_ORPHAN;
+  simplefs_writeInode(3, &inode);
+  struct fsck_report_t report;
+  printf("Fsck with orphan: %d\n", simplefs_fsck(2, 0, &report));
+  printf("Mount: %d\n", simplefs_mountDisk());
+  printf("Open orphan: %d\n", simplefs_open("f3"));
+  printf("Fsck after mount: %d\n", simplefs_fsck(2, 0, &report));
+  simplefs_dump();
+
+  // Orphans pointing at free or missing blocks are left to fsck
+  simplefs_delete("f4");
+  simplefs_create("f4");
+  int fd4 = simplefs_open("f4");
+  simplefs_write(fd4, block, BLOCKSIZE);
+  simplefs_close(fd4);
+  int inodenum = simplefs_findInode("f4");
+  struct superblock_t superblock;
+  simplefs_readSuperBlock(&superblock);
+  int freeblock = -1;
+  for (int i = 0; i < NUM_DATA_BLOCKS && freeblock == -1; i++)
+    if (superblock.datablock_freelist[i] == DATA_BLOCK_FREE)
+      freeblock = i;
+  simplefs_readInode(inodenum, &inode);
+  inode.status = INODE_ORPHAN;
+  inode.direct_blocks[1] = freeblock;
+  inode.direct_blocks[2] = 100000;
+  simplefs_writeInode(inodenum, &inode);
+  printf("Fsck bad orphan: %d\n", simplefs_fsck(2, 0, &report) > 0);
+  printf("Mount bad orphan: %d\n", simplefs_mountDisk());
+  printf("Open bad orphan: %d\n", simplefs_open("f4"));
+  printf("Fsck after mount: %d\n", simplefs_fsck(2, 0, &report));
+  return 0;
+}
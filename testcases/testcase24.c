@@ -0,0 +1,55 @@
+#include "simplefs-fsck.h"
+#include "simplefs-ops.h"
+
+#include <errno.h>
+
+// Print the free space the superblock records
+void show() {
+  struct statfs_t statfs;
+  simplefs_statfs(&statfs);
+  printf("Free blocks: %d/%d\tFree inodes: %d/%d\tBlock size: %d\n",
+         statfs.free_blocks, statfs.total_blocks, statfs.free_inodes,
+         statfs.total_inodes, statfs.block_size);
+}
+
+int main() {
+
+  char block[MAX_FILE_SIZE * BLOCKSIZE];
+  memset(block, 'a', sizeof(block));
+  simplefs_formatDisk();
+  show();
+
+  // Seven full files leave two blocks
+  char name[MAX_NAME_STRLEN + 1];
+  for (int i = 0; i < 7; i++) {
+    sprintf(name, "f%d", i);
+    simplefs_create(name);
+    int fd = simplefs_open(name);
+    simplefs_write(fd, block, sizeof(block));
+    simplefs_close(fd);
+  }
+  show();
+
+  // A write needing three blocks fails before taking any
+  simplefs_create("g");
+  int fd = simplefs_open("g");
+  errno = 0;
+  int ret = simplefs_write(fd, block, 3 * BLOCKSIZE);
+  printf("Write 3 blocks: %d\tENOSPC: %d\n", ret, errno == ENOSPC);
+  show();
+  printf("Write 2 blocks: %d\n", simplefs_write(fd, block, 2 * BLOCKSIZE));
+  show();
+  simplefs_close(fd);
+
+  // Deleting gives the blocks and the inode back
+  simplefs_delete("f0");
+  show();
+
+  // The counts are kept on disk
+  simplefs_mountDisk();
+  show();
+  struct fsck_report_t report;
+  printf("Fsck: %d\n", simplefs_fsck(2, 0, &report));
+  simplefs_dump();
+  return 0;
+}
@@ -0,0 +1,61 @@
+#include "simplefs-fsck.h"
+#include "simplefs-ops.h"
+
+// Print the first `nbytes` of file `name`, holes as dots
+void show(char *name, int nbytes) {
+  char buf[MAX_FILE_SIZE * BLOCKSIZE + 1];
+  int fd = simplefs_open(name);
+  simplefs_read(fd, buf, nbytes);
+  simplefs_close(fd);
+  for (int i = 0; i < nbytes; i++)
+    if (buf[i] == '\0')
+      buf[i] = '.';
+  buf[nbytes] = '\0';
+  printf("%s: %s\n", name, buf);
+}
+
+int main() {
+
+  // Four blocks of different letters
+  char data[MAX_FILE_SIZE * BLOCKSIZE];
+  for (int i = 0; i < MAX_FILE_SIZE * BLOCKSIZE; i++)
+    data[i] = 'A' + i / BLOCKSIZE;
+  simplefs_formatDisk();
+  simplefs_create("a");
+  int fda = simplefs_open("a");
+  simplefs_write(fda, data, sizeof(data));
+
+  // A whole file is shared block by block
+  simplefs_create("b");
+  int fdb = simplefs_open("b");
+  printf("Copy whole: %d\n",
+         simplefs_copy_file_range(fda, 0, fdb, 0, sizeof(data)));
+  show("b", sizeof(data));
+
+  // Head and tail go through a buffer, the block in between is shared
+  simplefs_create("c");
+  int fdc = simplefs_open("c");
+  printf("Copy aligned: %d\n",
+         simplefs_copy_file_range(fda, 40, fdc, 40, 150));
+  show("c", 190);
+
+  // Ranges not lined up are copied through a buffer
+  printf("Copy unaligned: %d\n",
+         simplefs_copy_file_range(fda, 60, fdc, 200, 30));
+  show("c", 230);
+  printf("Copy past end: %d\n",
+         simplefs_copy_file_range(fda, 200, fdc, 0, 100));
+
+  // Writing to a shared block gives the writer its own copy
+  simplefs_pwrite(fdb, "written", 7, 0);
+  show("a", 16);
+  show("b", 16);
+  simplefs_close(fda);
+  simplefs_close(fdb);
+  simplefs_close(fdc);
+
+  struct fsck_report_t report;
+  printf("Fsck: %d\n", simplefs_fsck(2, 0, &report));
+  simplefs_dump();
+  return 0;
+}
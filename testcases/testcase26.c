@@ -0,0 +1,79 @@
+#include "simplefs-ops.h"
+#include "simplefs-snapshot.h"
+#include "simplefs-view.h"
+
+// Print `nbytes` of file `name` at `offset`, read the usual way
+void show(char *name, int offset, int nbytes) {
+  char buf[MAX_FILE_SIZE * BLOCKSIZE + 1];
+  int fd = simplefs_open(name);
+  simplefs_pread(fd, buf, nbytes, offset);
+  simplefs_close(fd);
+  buf[nbytes] = '\0';
+  printf("%s: %s\n", name, buf);
+}
+
+int main() {
+
+  char data[MAX_FILE_SIZE * BLOCKSIZE];
+  for (int i = 0; i < MAX_FILE_SIZE * BLOCKSIZE; i++)
+    data[i] = 'a' + i % 26;
+  simplefs_formatDisk();
+  simplefs_create("f1");
+  int fd1 = simplefs_open("f1");
+  simplefs_write(fd1, data, sizeof(data));
+
+  // Consecutive blocks of a file are used in place, writes reach the disk
+  char *map = simplefs_mmap(fd1, 60, 10);
+  printf("Mapped: %.10s\n", map);
+  memcpy(map, "0123456789", 10);
+  printf("Msync: %d\n", simplefs_msync(map));
+  show("f1", 60, 10);
+  printf("Munmap: %d\n", simplefs_munmap(map));
+  printf("Munmap again: %d\n", simplefs_munmap(map));
+  printf("Past end: %d\n", simplefs_mmap(fd1, 250, 10) == NULL);
+
+  // Shared blocks get a private copy, written back by msync
+  simplefs_clone("f1", "f2");
+  int fd2 = simplefs_open("f2");
+  map = simplefs_mmap(fd2, 0, 8);
+  memcpy(map, "copy-on-", 8);
+  show("f2", 0, 8);
+  printf("Msync: %d\n", simplefs_msync(map));
+  show("f2", 0, 8);
+  show("f1", 0, 8);
+  simplefs_munmap(map);
+
+  // Snapshots can be mapped but not written back
+  int snapshot = simplefs_snapshot();
+  int fd3 = simplefs_snapshot_open(snapshot, "f1");
+  map = simplefs_mmap(fd3, 60, 10);
+  printf("Snapshot: %.10s\tMsync: %d\n", map, simplefs_msync(map));
+  simplefs_munmap(map);
+
+  simplefs_close(fd1);
+  simplefs_close(fd2);
+  simplefs_close(fd3);
+  simplefs_dump();
+
+  // A direct mapping turns private when its file is cloned, the clone keeps
+  // the old data and msync writes to the file alone
+  simplefs_create("f3");
+  int fd4 = simplefs_open("f3");
+  simplefs_write(fd4, data, BLOCKSIZE);
+  map = simplefs_mmap(fd4, 0, 8);
+  printf("Clone: %d\n", simplefs_clone("f3", "f4") != -1);
+  memcpy(map, "private!", 8);
+  show("f3", 0, 8);
+  show("f4", 0, 8);
+  printf("Msync: %d\n", simplefs_msync(map));
+  show("f3", 0, 8);
+  show("f4", 0, 8);
+
+  // Once the file is deleted its mapping is written nowhere
+  simplefs_close(fd4);
+  simplefs_delete("f3");
+  simplefs_create("f5");
+  printf("Msync deleted: %d\n", simplefs_msync(map));
+  simplefs_munmap(map);
+  return 0;
+}
@@ -0,0 +1,66 @@
+#include "simplefs-fsck.h"
+#include "simplefs-ops.h"
+#include "simplefs-stripe.h"
+
+// Print the first bytes of each data block image `name` holds from block
+// `start` on
+void member(char *name, int start, int blocks) {
+  char buf[BLOCKSIZE];
+  int fd = open(name, O_RDONLY);
+  printf("%s:", name);
+  for (int i = 0; i < blocks; i++) {
+    pread(fd, buf, BLOCKSIZE, (start + i) * BLOCKSIZE);
+    printf(" %.4s", buf[0] ? buf : "....");
+  }
+  printf("\n");
+  close(fd);
+}
+
+int main() {
+
+  // Blocks of four letters each
+  char data[MAX_FILE_SIZE * BLOCKSIZE];
+  for (int i = 0; i < MAX_FILE_SIZE * BLOCKSIZE; i++)
+    data[i] = 'A' + i / BLOCKSIZE % 4 * 4 + i % 4;
+  printf("Bad layout: %d\n", simplefs_formatStripedDisk(0, 5, 2));
+
+  // Three members, two blocks at a time
+  printf("Format: %d\n", simplefs_formatStripedDisk(0, 3, 2));
+  simplefs_create("f1");
+  int fd = simplefs_open("f1");
+  simplefs_write(fd, data, sizeof(data));
+  simplefs_close(fd);
+  simplefs_create("f2");
+  fd = simplefs_open("f2");
+  simplefs_write(fd, data + BLOCKSIZE, 2 * BLOCKSIZE);
+  simplefs_close(fd);
+  member("simplefs", DATA_BLOCK_START, 4);
+  member("simplefs.1", 1, 4);
+  member("simplefs.2", 1, 4);
+
+  // The whole set is needed to mount
+  printf("Mount: %d\n", simplefs_mountDisk());
+  char buf[MAX_FILE_SIZE * BLOCKSIZE];
+  fd = simplefs_open("f1");
+  simplefs_read(fd, buf, sizeof(buf));
+  printf("Read back: %d\n", memcmp(buf, data, sizeof(data)));
+  simplefs_close(fd);
+  struct fsck_report_t report;
+  printf("Fsck: %d\n", simplefs_fsck(2, 0, &report));
+
+  // A member labelled for another place is turned down
+  int member_fd = open("simplefs.2", O_RDWR);
+  struct superblock_t label;
+  pread(member_fd, &label, sizeof(label), 0);
+  label.stripe_index = 1;
+  pwrite(member_fd, &label, sizeof(label), 0);
+  close(member_fd);
+  printf("Mount with wrong member: %d\n", simplefs_mountDisk());
+  remove("simplefs.2");
+  printf("Mount without member: %d\n", simplefs_mountDisk());
+
+  simplefs_formatDisk();
+  printf("Mount unstriped: %d\n", simplefs_mountDisk());
+  remove("simplefs.1");
+  return 0;
+}
@@ -0,0 +1,98 @@
+#include "simplefs-fsck.h"
+#include "simplefs-ops.h"
+#include "simplefs-shared.h"
+
+#include <sys/wait.h>
+
+#define SEGMENT "/simplefs-testcase28"
+#define WORKERS 4
+#define APPENDS 12
+
+// Attach to the segment, write a file of its own and append to "log" from
+// worker `n` running in a child process
+void worker(int n) {
+  char name[MAX_NAME_STRLEN + 1];
+  char data[100];
+  if (simplefs_attachShared(SEGMENT) == -1)
+    _exit(1);
+  sprintf(name, "f%d", n);
+  memset(data, 'a' + n, sizeof(data));
+  simplefs_create(name);
+  int fd = simplefs_open(name);
+  int ret = simplefs_write(fd, data, sizeof(data));
+  simplefs_close(fd);
+
+  fd = simplefs_open_append("log");
+  for (int i = 0; i < APPENDS && ret == 0; i++)
+    ret = simplefs_write(fd, data, 4);
+  simplefs_close(fd);
+  simplefs_detachShared();
+  _exit(ret == 0 ? 0 : 1);
+}
+
+int main() {
+
+  simplefs_unlinkShared(SEGMENT);
+  simplefs_formatDisk();
+  simplefs_create("log");
+
+  // A process dying with the lock held doesn't keep the others out
+  pid_t pid = fork();
+  if (pid == 0) {
+    simplefs_attachShared(SEGMENT);
+    simplefs_lockMetadata();
+    _exit(0);
+  }
+  int status;
+  waitpid(pid, &status, 0);
+
+  // Workers change the disk at the same time
+  pid_t pids[WORKERS];
+  for (int n = 0; n < WORKERS; n++) {
+    pids[n] = fork();
+    if (pids[n] == 0)
+      worker(n);
+  }
+  for (int n = 0; n < WORKERS; n++) {
+    waitpid(pids[n], &status, 0);
+    printf("Worker %d: %d\n", n, WEXITSTATUS(status));
+  }
+
+  // Every worker's file and all of its appends are there
+  printf("Attach: %d\n", simplefs_attachShared(SEGMENT));
+  printf("Attach again: %d\n", simplefs_attachShared(SEGMENT));
+  char buf[MAX_FILE_SIZE * BLOCKSIZE];
+  for (int n = 0; n < WORKERS; n++) {
+    char name[MAX_NAME_STRLEN + 1];
+    sprintf(name, "f%d", n);
+    int fd = simplefs_open(name);
+    int ret = simplefs_read(fd, buf, 100);
+    simplefs_close(fd);
+    printf("%s: %d %.10s\n", name, ret, buf);
+  }
+  int fd = simplefs_open("log");
+  int counts[WORKERS] = {0};
+  int ret = simplefs_read(fd, buf, WORKERS * APPENDS * 4);
+  simplefs_close(fd);
+  for (int i = 0; i < WORKERS * APPENDS * 4; i++)
+    if (buf[i] >= 'a' && buf[i] < 'a' + WORKERS)
+      counts[buf[i] - 'a']++;
+  printf("log: %d", ret);
+  for (int n = 0; n < WORKERS; n++)
+    printf(" %c=%d", 'a' + n, counts[n]);
+  printf("\n");
+
+  struct statfs_t statfs;
+  simplefs_statfs(&statfs);
+  printf("Free blocks: %d\tFree inodes: %d\n", statfs.free_blocks,
+         statfs.free_inodes);
+  printf("Detach: %d\n", simplefs_detachShared());
+  printf("Detach again: %d\n", simplefs_detachShared());
+  printf("Unlink: %d\n", simplefs_unlinkShared(SEGMENT));
+
+  // The disk holds what the segment did
+  simplefs_mountDisk();
+  struct fsck_report_t report;
+  printf("Fsck: %d\n", simplefs_fsck(2, 0, &report));
+  return 0;
+}
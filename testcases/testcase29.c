@@ -0,0 +1,65 @@
+#include "simplefs-build.h"
+#include "simplefs-fsck.h"
+#include "simplefs-ops.h"
+
+// Write `nbytes` of the 16 letters from `first` to host file `name`
+void host(char *name, char first, int nbytes) {
+  char buf[MAX_FILE_SIZE * BLOCKSIZE];
+  for (int i = 0; i < nbytes; i++)
+    buf[i] = first + i % 16;
+  int fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  write(fd, buf, nbytes);
+  close(fd);
+}
+
+// Print the first bytes of file `path` on the disk
+void show(char *path) {
+  char buf[MAX_FILE_SIZE * BLOCKSIZE];
+  int fd = simplefs_open(path);
+  simplefs_read(fd, buf, 12);
+  simplefs_close(fd);
+  printf("%s: %.12s\n", path, buf);
+}
+
+int main() {
+
+  host("build-a", 'a', 20);
+  host("build-b", 'A', 200);
+  host("build-c", 'k', 100);
+  struct build_file_t files[] = {
+      {"small", "build-a", 20},
+      {"large", "build-b", 200},
+      {"docs", NULL, 0},
+      {"docs/deep/notes", "build-c", 100},
+  };
+
+  // Small files stay inline, the others get consecutive blocks
+  printf("Build: %d\n", simplefs_buildImage(files, 4, 3));
+  show("small");
+  show("large");
+  show("docs/deep/notes");
+  struct fsck_report_t report;
+  printf("Fsck: %d\n", simplefs_fsck(2, 0, &report));
+  simplefs_dump();
+
+  // A tree that doesn't fit leaves an empty disk
+  struct build_file_t too_many[NUM_INODES + 1];
+  char names[NUM_INODES + 1][MAX_NAME_STRLEN + 1];
+  for (int i = 0; i <= NUM_INODES; i++) {
+    sprintf(names[i], "f%d", i);
+    too_many[i].path = names[i];
+    too_many[i].source = "build-a";
+    too_many[i].size = 20;
+  }
+  printf("Too many files: %d\n", simplefs_buildImage(too_many, 9, 4));
+  printf("Open f0: %d\n", simplefs_open("f0"));
+
+  // So does a host file shorter than said
+  files[1].size = 250;
+  printf("Short host file: %d\n", simplefs_buildImage(files, 4, 2));
+  printf("Open small: %d\n", simplefs_open("small"));
+  remove("build-a");
+  remove("build-b");
+  remove("build-c");
+  return 0;
+}
@@ -0,0 +1,68 @@
+#include "simplefs-dir.h"
+#include "simplefs-ops.h"
+#include "simplefs-snapshot.h"
+
+// Print what simplefs_stat or simplefs_fstat found
+void show(char *what, int ret, struct stat_t *st) {
+  if (ret == -1)
+    printf("%s: -1\n", what);
+  else
+    printf("%s: inode %d size %d blocks %d flags %d\n", what,
+           st->inode_number, st->size, st->blocks, st->flags);
+}
+
+int main() {
+
+  char data[MAX_FILE_SIZE * BLOCKSIZE];
+  memset(data, 'a', sizeof(data));
+  simplefs_formatDisk();
+  char name[MAX_NAME_STRLEN + 1];
+  for (int i = 0; i < 4; i++) {
+    sprintf(name, "f%d", i);
+    simplefs_create(name);
+    int fd = simplefs_open(name);
+    simplefs_write(fd, data, 20 + 60 * i);
+    simplefs_close(fd);
+  }
+  simplefs_mkdir("dir");
+  simplefs_create("dir/inside-a-directory");
+  simplefs_delete("f1");
+
+  // Two entries at a time, picking up where the last call stopped
+  struct list_entry_t entries[2];
+  int cursor = 0, count;
+  while ((count = simplefs_list(&cursor, entries, 2)) > 0) {
+    printf("Batch of %d, cursor %d:", count, cursor);
+    for (int i = 0; i < count; i++)
+      printf(" %d=%s/%d/%d", entries[i].inode_number, entries[i].name,
+             entries[i].size, entries[i].flags);
+    printf("\n");
+  }
+
+  // A name inside a directory doesn't hide one at the root
+  simplefs_create("inside-a");
+  cursor = 0;
+  printf("Listed: %d\n", simplefs_list(&cursor, entries, 0));
+  printf("Root inside-a: %d\n", simplefs_open("inside-a") != -1);
+
+  // By name, path and handle
+  struct stat_t st;
+  show("f3", simplefs_stat("f3", &st), &st);
+  show("f1", simplefs_stat("f1", &st), &st);
+  show("dir", simplefs_stat("dir", &st), &st);
+  show("dir/inside-a-directory",
+       simplefs_stat("dir/inside-a-directory", &st), &st);
+  int fd = simplefs_open("f2");
+  show("Handle", simplefs_fstat(fd, &st), &st);
+
+  // Snapshot handles see the file as it was
+  int snapshot = simplefs_snapshot();
+  int old = simplefs_snapshot_open(snapshot, "f2");
+  simplefs_truncate(fd, 10);
+  show("Truncated", simplefs_fstat(fd, &st), &st);
+  show("Snapshot", simplefs_fstat(old, &st), &st);
+  simplefs_close(fd);
+  simplefs_close(old);
+  show("Closed", simplefs_fstat(fd, &st), &st);
+  return 0;
+}
@@ -0,0 +1,122 @@
+#include "simplefs-fsck.h"
+#include "simplefs-ops.h"
+#include "simplefs-scrub.h"
+#include "simplefs-view.h"
+
+#include <errno.h>
+
+// Flip a byte of data block `blocknum` behind the file system's back
+void corrupt(int blocknum) {
+  int fd = open("simplefs", O_RDWR);
+  char c;
+  off_t offset = (DATA_BLOCK_START + blocknum) * BLOCKSIZE + 5;
+  pread(fd, &c, 1, offset);
+  c ^= 0x20;
+  pwrite(fd, &c, 1, offset);
+  close(fd);
+}
+
+// Read `nbytes` at `offset` of `name`, printing what came back
+void show(char *name, int offset, int nbytes) {
+  char buf[MAX_FILE_SIZE * BLOCKSIZE + 1];
+  int fd = simplefs_open(name);
+  simplefs_seek(fd, offset);
+  errno = 0;
+  int ret = simplefs_read(fd, buf, nbytes);
+  buf[ret == 0 ? nbytes : 0] = '\0';
+  printf("%s: %d%s %s\n", name, ret, errno == EIO ? " EIO" : "", buf);
+  simplefs_close(fd);
+}
+
+// Write two files, the first on data blocks 0 and 1
+void fill() {
+  char data[2 * BLOCKSIZE];
+  for (int i = 0; i < 2 * BLOCKSIZE; i++)
+    data[i] = 'a' + i % 26;
+  simplefs_create("f0");
+  int fd = simplefs_open("f0");
+  simplefs_write(fd, data, sizeof(data));
+  simplefs_close(fd);
+  simplefs_create("f1");
+  fd = simplefs_open("f1");
+  simplefs_write(fd, data + 1, BLOCKSIZE);
+  simplefs_close(fd);
+}
+
+int main() {
+
+  // Damage is caught by reads that reach the block, others go on
+  simplefs_formatDiskWithFeatures(FEATURE_CHECKSUM);
+  fill();
+  show("f0", 0, 10);
+  printf("Scrub: %d\n", simplefs_scrub());
+  corrupt(1);
+  show("f0", 0, 10);
+  show("f0", 60, 10);
+  show("f1", 0, 10);
+  int fd = simplefs_open("f0");
+  struct view_t views[MAX_VIEW_SEGMENTS];
+  printf("View: %d\n", simplefs_read_view(fd, 2 * BLOCKSIZE, views));
+  printf("Map: %d\n", simplefs_mmap(fd, 0, 2 * BLOCKSIZE) != NULL);
+
+  // A partial write doesn't make the damage pass for good data
+  simplefs_seek(fd, BLOCKSIZE + 2);
+  printf("Partial write: %d\n", simplefs_write(fd, "ZZ", 2));
+  printf("Scrub: %d\n", simplefs_scrub());
+
+  // The scrubber finds it without anyone reading the file
+  printf("Start: %d\n", simplefs_startScrubber(100000));
+  printf("Start again: %d\n", simplefs_startScrubber(100000));
+  struct scrub_report_t report;
+  do {
+    usleep(1000);
+    simplefs_scrubReport(&report);
+  } while (report.passes == 0);
+  simplefs_stopScrubber();
+  printf("Scrubber: %d bad, last %d\n", report.bad_blocks, report.last_bad);
+
+  // Overwriting the whole block repairs it, checksums survive a remount
+  char data[BLOCKSIZE];
+  memset(data, 'z', BLOCKSIZE);
+  simplefs_seek(fd, -2);
+  printf("Whole write: %d\n", simplefs_write(fd, data, BLOCKSIZE));
+  simplefs_close(fd);
+  printf("Mount: %d\n", simplefs_mountDisk());
+  show("f0", 60, 10);
+  printf("Scrub: %d\n", simplefs_scrub());
+
+  // Truncating or appending into a damaged block fails and changes nothing
+  corrupt(1);
+  fd = simplefs_open("f0");
+  printf("Truncate: %d\n", simplefs_truncate(fd, BLOCKSIZE + 3));
+  simplefs_close(fd);
+  simplefs_create("f2");
+  fd = simplefs_open("f2");
+  simplefs_write(fd, data, BLOCKSIZE);
+  simplefs_seek(fd, BLOCKSIZE);
+  simplefs_write(fd, data, 6);
+  simplefs_close(fd);
+  corrupt(4);
+  fd = simplefs_open_append("f2");
+  printf("Append: %d\n", simplefs_write(fd, "ZZ", 2));
+  simplefs_close(fd);
+  struct fsck_report_t fsck;
+  printf("Fsck: %d, scrub: %d\n", simplefs_fsck(1, 0, &fsck), simplefs_scrub());
+
+  // Compressed chunks are checked when they are read again
+  simplefs_formatDiskWithFeatures(FEATURE_CHECKSUM | FEATURE_COMPRESSION);
+  fill();
+  corrupt(0);
+  simplefs_mountDisk();
+  show("f0", 0, 10);
+  show("f1", 0, 10);
+
+  // Disks without checksums notice nothing
+  simplefs_formatDisk();
+  fill();
+  corrupt(1);
+  show("f0", 60, 10);
+  printf("Scrub: %d\n", simplefs_scrub());
+  printf("Start: %d\n", simplefs_startScrubber(100));
+  return 0;
+}
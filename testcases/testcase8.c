@@ -0,0 +1,35 @@
+#include "simplefs-ops.h"
+
+int main() {
+
+  simplefs_formatDiskWithFeatures(FEATURE_COMPRESSION);
+  simplefs_create("fileabc");
+  int fd = simplefs_open("fileabc");
+  char str[] =
+      "!-----------------------64 Bytes of Data-----------------------!";
+  printf("Write Data: %d\n", simplefs_write(fd, str, BLOCKSIZE));
+  printf("Seek: %d\n", simplefs_seek(fd, BLOCKSIZE));
+  printf("Write Data: %d\n", simplefs_write(fd, str, BLOCKSIZE));
+  printf("Seek: %d\n", simplefs_seek(fd, BLOCKSIZE));
+  printf("Write Data: %d\n", simplefs_write(fd, str, BLOCKSIZE));
+  printf("Seek: %d\n", simplefs_seek(fd, BLOCKSIZE));
+  printf("Write Data: %d\n", simplefs_write(fd, str, BLOCKSIZE));
+  printf("Seek: %d\n", simplefs_seek(fd, -BLOCKSIZE * 3 + 24));
+  printf("Write Data: %d\n", simplefs_write(fd, "32", 2));
+  char buf[BLOCKSIZE * MAX_FILE_SIZE + 1];
+  buf[BLOCKSIZE * MAX_FILE_SIZE] = '\0';
+  printf("Seek: %d\n", simplefs_seek(fd, -24));
+  printf("Read Data %d\n", simplefs_read(fd, buf, BLOCKSIZE * MAX_FILE_SIZE));
+  printf("Data: %s\n", buf);
+  char buf2[BLOCKSIZE + 1];
+  buf2[BLOCKSIZE] = '\0';
+  printf("Seek: %d\n", simplefs_seek(fd, BLOCKSIZE / 2));
+  printf("Read Data %d\n", simplefs_read(fd, buf2, BLOCKSIZE));
+  printf("Data: %s\n", buf2);
+  simplefs_close(fd);
+  simplefs_dump();
+  simplefs_delete("fileabc");
+  simplefs_dump();
+
+  return 0;
+}
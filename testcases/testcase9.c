@@ -0,0 +1,28 @@
+#include "simplefs-ops.h"
+
+int main() {
+
+  simplefs_formatDisk();
+  simplefs_create("fileabc");
+  int fd = simplefs_open("fileabc");
+  char str[] = "!---16 Bytes---!";
+  printf("Write Data: %d\n", simplefs_write(fd, str, 16));
+  printf("Seek: %d\n", simplefs_seek(fd, 16));
+  printf("Write Data: %d\n", simplefs_write(fd, str, 12));
+  char buf[BLOCKSIZE + 1];
+  buf[28] = '\0';
+  printf("Seek: %d\n", simplefs_seek(fd, -16));
+  printf("Read Data %d\n", simplefs_read(fd, buf, 28));
+  printf("Data: %s\n", buf);
+  simplefs_dump();
+  printf("Seek: %d\n", simplefs_seek(fd, 28));
+  printf("Write Data: %d\n", simplefs_write(fd, str, 16));
+  buf[44] = '\0';
+  printf("Seek: %d\n", simplefs_seek(fd, -28));
+  printf("Read Data %d\n", simplefs_read(fd, buf, 44));
+  printf("Data: %s\n", buf);
+  simplefs_close(fd);
+  simplefs_dump();
+
+  return 0;
+}
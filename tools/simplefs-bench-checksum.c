@@ -0,0 +1,101 @@
+// Compare block reads and writes on disks with and without FEATURE_CHECKSUM
+// Build: gcc -O2 -I. tools/simplefs-bench-checksum.c simplefs-*.c -pthread
+//          -o simplefs-bench-checksum
+// Usage: ./simplefs-bench-checksum [operations]
+#include "simplefs-batch.h"
+#include "simplefs-checksum.h"
+
+#include <time.h>
+
+#define FILES 6
+#define BATCH_OPS 16 // Writes per simplefs_submit when batched
+
+// How the operations are run
+#define MODE_READ 0
+#define MODE_WRITE 1
+#define MODE_BATCH 2 // writes through simplefs_submit
+
+// Seconds since an arbitrary point
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Run `ops` random whole block operations of `mode` over full files on a
+// disk formatted with `features`. Returns MB/s
+static double bench(int features, int mode, int ops) {
+  char data[MAX_FILE_SIZE * BLOCKSIZE];
+  char buf[BLOCKSIZE];
+  memset(data, 'a', sizeof(data));
+  simplefs_formatDiskWithFeatures(features);
+  int fds[FILES];
+  for (int i = 0; i < FILES; i++) {
+    char name[MAX_NAME_STRLEN];
+    sprintf(name, "f%d", i);
+    simplefs_create(name);
+    fds[i] = simplefs_open(name);
+    simplefs_write(fds[i], data, sizeof(data));
+  }
+
+  srand(1);
+  struct batch_op_t batch[BATCH_OPS];
+  int failed = 0;
+  double start = now();
+  for (int n = 0; n < ops; n++) {
+    int fd = fds[rand() % FILES];
+    int offset = rand() % MAX_FILE_SIZE * BLOCKSIZE;
+    if (mode == MODE_READ) {
+      failed += simplefs_pread(fd, buf, BLOCKSIZE, offset) != 0;
+    } else if (mode == MODE_WRITE) {
+      failed += simplefs_pwrite(fd, data, BLOCKSIZE, offset) != 0;
+    } else {
+      struct batch_op_t *op = &batch[n % BATCH_OPS];
+      op->op = BATCH_WRITE;
+      op->file_handle = fd;
+      op->buf = data;
+      op->nbytes = BLOCKSIZE;
+      op->offset = offset;
+      if (n % BATCH_OPS == BATCH_OPS - 1 || n == ops - 1)
+        failed += simplefs_submit(batch, n % BATCH_OPS + 1);
+    }
+  }
+  double elapsed = now() - start;
+  if (failed) {
+    printf("%d operations failed\n", failed);
+    exit(1);
+  }
+  for (int i = 0; i < FILES; i++)
+    simplefs_close(fds[i]);
+  return ops * (double)BLOCKSIZE / elapsed / 1e6;
+}
+
+// Checksum `blocks` blocks in memory, the cost added to each block moved.
+// Returns MB/s
+static double benchCrc(int blocks) {
+  char block[BLOCKSIZE];
+  memset(block, 'a', BLOCKSIZE);
+  uint32_t crc = 0;
+  double start = now();
+  for (int n = 0; n < blocks; n++) {
+    block[0] = (char)crc;
+    crc = simplefs_crc32c(0, block, BLOCKSIZE);
+  }
+  double elapsed = now() - start;
+  if (crc == 0)
+    printf("\n");
+  return blocks * (double)BLOCKSIZE / elapsed / 1e6;
+}
+
+int main(int argc, char *argv[]) {
+  int ops = argc > 1 ? atoi(argv[1]) : 200000;
+  const char *modes[] = {"Reads", "Writes", "Batched writes"};
+  for (int mode = MODE_READ; mode <= MODE_BATCH; mode++) {
+    double plain = bench(0, mode, ops);
+    double checked = bench(FEATURE_CHECKSUM, mode, ops);
+    printf("%s: %.2f MB/s plain, %.2f MB/s checksummed (%+.1f%%)\n",
+           modes[mode], plain, checked, (checked / plain - 1) * 100);
+  }
+  printf("CRC32C: %.0f MB/s\n", benchCrc(ops * 10));
+  return 0;
+}
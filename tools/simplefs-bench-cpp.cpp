@@ -0,0 +1,89 @@
+// Compare reads through the C API with the C++ layer, which wraps it, to
+// check the layer costs next to nothing
+// Build: gcc -O2 -I. -c simplefs-*.c && g++ -std=c++20 -O2 -I.
+//          tools/simplefs-bench-cpp.cpp simplefs-*.o -pthread
+//          -o simplefs-bench-cpp
+// Usage: ./simplefs-bench-cpp [reads]
+#include "simplefs.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using simplefs::Disk;
+
+struct Read {
+  int file, offset, length;
+};
+
+// Seconds taken by `fn`
+template <typename Fn> static double timed(Fn fn) {
+  auto start = std::chrono::steady_clock::now();
+  fn();
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+int main(int argc, char *argv[]) {
+  int count = argc > 1 ? atoi(argv[1]) : 200000;
+  constexpr int num_files = 4;
+
+  // Full files, every other one with its blocks scattered
+  Disk::format();
+  std::vector<Disk::File> files;
+  char data[Disk::max_file_size];
+  for (int i = 0; i < Disk::max_file_size; i++)
+    data[i] = 'a' + i % 26;
+  for (int i = 0; i < num_files; i++) {
+    std::string name = "f" + std::to_string(i);
+    Disk::create(name);
+    files.push_back(Disk::open(name));
+    for (int b = 0; b < MAX_FILE_SIZE; b++)
+      files[i].write(std::span(data + b * BLOCKSIZE, BLOCKSIZE),
+                     b * BLOCKSIZE);
+  }
+
+  std::mt19937 rng(1);
+  std::vector<Read> reads(count);
+  for (auto &r : reads) {
+    r.file = rng() % num_files;
+    r.offset = rng() % Disk::max_file_size;
+    r.length = 1 + rng() % (Disk::max_file_size - r.offset);
+  }
+
+  // Both paths have to return the same bytes
+  char a[Disk::max_file_size], b[Disk::max_file_size];
+  for (int i = 0; i < 1000 && i < count; i++) {
+    auto &r = reads[i];
+    simplefs_pread(files[r.file].handle(), a, r.length, r.offset);
+    files[r.file].read(std::span(b, r.length), r.offset);
+    if (std::memcmp(a, b, r.length)) {
+      printf("Mismatch\n");
+      return 1;
+    }
+  }
+
+  long bytes = 0;
+  for (auto &r : reads)
+    bytes += r.length;
+  double c = timed([&] {
+    for (auto &r : reads)
+      simplefs_pread(files[r.file].handle(), a, r.length, r.offset);
+  });
+  double cpp = timed([&] {
+    for (auto &r : reads)
+      files[r.file].read(std::span(b, r.length), r.offset);
+  });
+  printf("C API: %.2f MB/s\n", bytes / c / 1e6);
+  printf("C++ layer: %.2f MB/s\n", bytes / cpp / 1e6);
+  printf("Free blocks: %d\n", Disk::freeBlocks());
+
+  // Closed files and bad handles read nothing
+  files[0].close();
+  printf("Read closed: %d\n", files[0].read(std::span(a, 1), 0));
+  printf("Read bad handle: %d\n", Disk::File(-1).read(std::span(a, 1), 0));
+  return 0;
+}
@@ -0,0 +1,78 @@
+// Compare read throughput of a fragmented disk before and after defrag
+// Build: gcc -O2 -I. tools/simplefs-bench-defrag.c simplefs-*.c -pthread
+//          -o simplefs-bench-defrag
+// Usage: ./simplefs-bench-defrag [reads]
+#include "simplefs-defrag.h"
+#include "simplefs-ops.h"
+
+#include <time.h>
+
+#define NUM_FILES 6
+
+// Seconds since an arbitrary point
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Read each file in `fds` whole `reads` times, returns MB/s
+static double bench(int *fds, int count, int reads) {
+  char buf[MAX_FILE_SIZE * BLOCKSIZE];
+  double start = now();
+  for (int n = 0; n < reads; n++) {
+    for (int i = 0; i < count; i++) {
+      if (simplefs_pread(fds[i], buf, sizeof(buf), 0)) {
+        printf("Read failed\n");
+        exit(1);
+      }
+    }
+  }
+  double elapsed = now() - start;
+  return reads * count * (double)sizeof(buf) / elapsed / 1e6;
+}
+
+// Print the average extents per file
+static void print_extents() {
+  struct stats_t stats;
+  simplefs_getStats(&stats);
+  printf("Extents per file: %.2f\n", stats.extents_per_file);
+}
+
+int main(int argc, char *argv[]) {
+  int reads = argc > 1 ? atoi(argv[1]) : 100000;
+  char block[BLOCKSIZE];
+  char name[MAX_NAME_STRLEN];
+  int fds[NUM_FILES];
+  memset(block, 'a', sizeof(block));
+
+  // Whole files written a block at a time, interleaved, then every other
+  // one deleted, leaves each file with one extent per block
+  simplefs_formatDisk();
+  for (int i = 0; i < NUM_FILES; i++) {
+    sprintf(name, "f%d", i);
+    simplefs_create(name);
+    fds[i] = simplefs_open(name);
+  }
+  for (int j = 0; j < MAX_FILE_SIZE; j++)
+    for (int i = 0; i < NUM_FILES; i++)
+      simplefs_pwrite(fds[i], block, BLOCKSIZE, j * BLOCKSIZE);
+  int kept = 0;
+  for (int i = 0; i < NUM_FILES; i++) {
+    if (i % 2 == 0) {
+      fds[kept++] = fds[i];
+      continue;
+    }
+    simplefs_close(fds[i]);
+    sprintf(name, "f%d", i);
+    simplefs_delete(name);
+  }
+
+  print_extents();
+  printf("Before defrag: %.2f MB/s\n", bench(fds, kept, reads));
+  while (simplefs_defrag(MAX_FILE_SIZE) > 0)
+    ;
+  print_extents();
+  printf("After defrag: %.2f MB/s\n", bench(fds, kept, reads));
+  return 0;
+}
@@ -0,0 +1,57 @@
+// Compare random-write throughput of the in-place and log-structured layouts
+// Build: gcc -O2 -I. tools/simplefs-bench-log.c simplefs-*.c -pthread
+//          -o simplefs-bench-log
+// Usage: ./simplefs-bench-log [writes]
+#include "simplefs-log.h"
+#include "simplefs-ops.h"
+
+#include <time.h>
+
+#define NUM_FILES 4
+#define WRITE_SIZE 16
+
+// Seconds since an arbitrary point
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Run `writes` random writes on a disk formatted with `features`, returns MB/s
+static double bench(int features, int writes) {
+  char data[MAX_FILE_SIZE * BLOCKSIZE];
+  char name[MAX_NAME_STRLEN];
+  int fds[NUM_FILES];
+  memset(data, 'a', sizeof(data));
+
+  // Fill the files first so every write overwrites data
+  simplefs_formatDiskWithFeatures(features);
+  for (int i = 0; i < NUM_FILES; i++) {
+    sprintf(name, "f%d", i);
+    simplefs_create(name);
+    fds[i] = simplefs_open(name);
+    simplefs_pwrite(fds[i], data, sizeof(data), 0);
+  }
+
+  // Log-structured disks leave the cleaning to the cleaner thread
+  simplefs_startCleaner();
+  srand(1);
+  double start = now();
+  for (int n = 0; n < writes; n++) {
+    int offset = rand() % (MAX_FILE_SIZE * BLOCKSIZE - WRITE_SIZE + 1);
+    if (simplefs_pwrite(fds[rand() % NUM_FILES], data, WRITE_SIZE, offset)) {
+      printf("Write failed\n");
+      exit(1);
+    }
+  }
+  double elapsed = now() - start;
+  simplefs_stopCleaner();
+  return writes * (double)WRITE_SIZE / elapsed / 1e6;
+}
+
+int main(int argc, char *argv[]) {
+  int writes = argc > 1 ? atoi(argv[1]) : 100000;
+  printf("In-place: %.2f MB/s\n", bench(0, writes));
+  printf("Log-structured: %.2f MB/s\n", bench(FEATURE_LOG, writes));
+  return 0;
+}
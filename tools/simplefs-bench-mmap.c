@@ -0,0 +1,68 @@
+// Compare random small reads through simplefs_mmap with simplefs_seek and
+// simplefs_read
+// Build: gcc -O2 -I. tools/simplefs-bench-mmap.c simplefs-*.c -pthread
+//          -o simplefs-bench-mmap
+// Usage: ./simplefs-bench-mmap [reads]
+#include "simplefs-ops.h"
+#include "simplefs-view.h"
+
+#include <time.h>
+
+#define READ_SIZE 16
+
+// Seconds since an arbitrary point
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Run `reads` random reads of a full file, through a mapping of the whole
+// file if `mapped` is set. Returns MB/s
+static double bench(int mapped, int reads) {
+  char data[MAX_FILE_SIZE * BLOCKSIZE];
+  char buf[READ_SIZE];
+  memset(data, 'a', sizeof(data));
+  simplefs_formatDisk();
+  simplefs_create("f");
+  int fd = simplefs_open("f");
+  simplefs_write(fd, data, sizeof(data));
+  char *map = mapped ? simplefs_mmap(fd, 0, sizeof(data)) : NULL;
+
+  // Reads leave the handle offset where the last seek put it
+  int position = 0;
+  srand(1);
+  long sum = 0;
+  double start = now();
+  for (int n = 0; n < reads; n++) {
+    int offset = rand() % (MAX_FILE_SIZE * BLOCKSIZE - READ_SIZE + 1);
+    if (mapped) {
+      memcpy(buf, map + offset, READ_SIZE);
+    } else if (simplefs_seek(fd, offset - position) ||
+               simplefs_read(fd, buf, READ_SIZE)) {
+      printf("Read failed\n");
+      exit(1);
+    } else {
+      position = offset;
+    }
+    sum += buf[n % READ_SIZE];
+  }
+  double elapsed = now() - start;
+
+  // Keep the reads from being optimised away
+  if (sum != (long)reads * 'a') {
+    printf("Bad data\n");
+    exit(1);
+  }
+  if (mapped)
+    simplefs_munmap(map);
+  simplefs_close(fd);
+  return reads * (double)READ_SIZE / elapsed / 1e6;
+}
+
+int main(int argc, char *argv[]) {
+  int reads = argc > 1 ? atoi(argv[1]) : 1000000;
+  printf("Seek and read: %.2f MB/s\n", bench(0, reads));
+  printf("Mapped: %.2f MB/s\n", bench(1, reads));
+  return 0;
+}
@@ -0,0 +1,37 @@
+// Check the simplefs disk in the current directory
+// Build: gcc -I. tools/simplefs-fsck.c simplefs-*.c -pthread -o simplefs-fsck
+// Usage: ./simplefs-fsck [-r] [-j threads]
+#include "simplefs-fsck.h"
+
+int main(int argc, char *argv[]) {
+  int repair = 0, nthreads = 4;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-r")) {
+      repair = 1;
+    } else if (!strcmp(argv[i], "-j") && i + 1 < argc) {
+      nthreads = atoi(argv[++i]);
+    } else {
+      printf("Usage: %s [-r] [-j threads]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  // Orphans are only reclaimed once their block numbers are checked
+  if (simplefs_openDisk() == -1) {
+    printf("No simplefs disk found\n");
+    return 2;
+  }
+
+  struct fsck_report_t report;
+  int errors = simplefs_fsck(nthreads, repair, &report);
+  if (repair)
+    simplefs_reclaim();
+  printf("Bad inodes: %d\n", report.bad_inodes);
+  printf("Duplicate blocks: %d\n", report.duplicate_blocks);
+  printf("Inode map errors: %d\n", report.inode_map_errors);
+  printf("Block map errors: %d\n", report.block_map_errors);
+  printf("%s\n", errors == 0       ? "Clean"
+                 : report.repaired ? "Repaired"
+                                   : "Errors found");
+  return errors == 0 || report.repaired ? 0 : 1;
+}
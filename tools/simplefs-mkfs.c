@@ -0,0 +1,74 @@
+// Build a simplefs disk in the current directory from a host directory tree
+// Build: gcc -O2 -I. tools/simplefs-mkfs.c simplefs-*.c -pthread
+//          -o simplefs-mkfs
+// Usage: ./simplefs-mkfs [-j threads] directory
+#define _XOPEN_SOURCE 700
+#include "simplefs-build.h"
+
+#include <ftw.h>
+
+// Files and directories found under the tree
+static struct build_file_t *found;
+static int nfound, capacity;
+static int root_len;
+
+// Note each file and directory below the root, with its path in the tree
+static int simplefs_collect(const char *fpath, const struct stat *sb,
+                            int typeflag, struct FTW *ftwbuf) {
+  if (ftwbuf->level == 0 || (typeflag != FTW_F && typeflag != FTW_D))
+    return 0;
+  if (typeflag == FTW_F && !S_ISREG(sb->st_mode))
+    return 0;
+  if (nfound == capacity) {
+    capacity = capacity ? 2 * capacity : 64;
+    found = (struct build_file_t *)realloc(
+        found, capacity * sizeof(struct build_file_t));
+  }
+  found[nfound].path = strdup(fpath + root_len + 1);
+  found[nfound].source = typeflag == FTW_F ? strdup(fpath) : NULL;
+  found[nfound].size = typeflag == FTW_F ? sb->st_size : 0;
+  nfound++;
+  return 0;
+}
+
+// Parents sort before what they hold, so the image is the same on every run
+static int simplefs_comparePaths(const void *a, const void *b) {
+  return strcmp(((struct build_file_t *)a)->path,
+                ((struct build_file_t *)b)->path);
+}
+
+int main(int argc, char *argv[]) {
+  int nthreads = 4, usage = 0;
+  char *root = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-j") && i + 1 < argc)
+      nthreads = atoi(argv[++i]);
+    else if (root == NULL && argv[i][0] != '-')
+      root = argv[i];
+    else
+      usage = 1;
+  }
+  if (usage || root == NULL) {
+    printf("Usage: %s [-j threads] directory\n", argv[0]);
+    return 2;
+  }
+
+  root_len = strlen(root);
+  while (root_len > 1 && root[root_len - 1] == '/')
+    root[--root_len] = '\0';
+  if (nftw(root, simplefs_collect, 16, FTW_PHYS) == -1) {
+    printf("Can't read %s\n", root);
+    return 2;
+  }
+  qsort(found, nfound, sizeof(struct build_file_t), simplefs_comparePaths);
+
+  int files = 0;
+  for (int i = 0; i < nfound; i++)
+    files += found[i].source != NULL;
+  if (simplefs_buildImage(found, nfound, nthreads) == -1) {
+    printf("%s doesn't fit a simplefs disk\n", root);
+    return 1;
+  }
+  printf("%d files, %d directories\n", files, nfound - files);
+  return 0;
+}